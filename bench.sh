@@ -0,0 +1,75 @@
+#!/bin/sh
+#  bench -- shell script to time the store readers and the tools that follow
+#           them on synthetic stores made by mkstore.
+#
+#  usage:  bench.sh [-M MB] [-d dir] [-k]
+#
+#  Makes a v3 and a v2 store of about MB megabytes (default 100) in dir
+#  (default /tmp/bench<pid>), with a few packets out of order, and times
+#     tv3mseed, tv2mseed - extraction of Z, N and E from each store
+#     sort - mseedsort listing, sort and rewrite of the Z data (as dosort.sh)
+#     split - splitseed into hour files
+#     gap - mseedgap -d on the hour files
+#  reporting for each the MB read, seconds, MB/s and packets (or records)
+#  per second.  The stores are made the same way every time, so runs may be
+#  compared from one build to another.  The directory is removed afterwards
+#  unless -k is given.  Uses programs on the PATH; "make bench" runs it with
+#  the programs just built.
+
+mb=100 dir=/tmp/bench$$ keep=
+while [ $# -gt 0 ]; do
+   case "$1" in
+      -M) mb=$2; shift 2;;
+      -d) dir=$2; shift 2;;
+      -k) keep=1; shift;;
+      *) echo "**usage: bench.sh [-M MB] [-d dir] [-k]"; exit 1;;
+   esac
+done
+
+now() {
+   date +%s.%N | sed 's/\.N$/.0/'
+}
+
+# report stage start bytes count
+report() {
+   echo "$1 $2 `now` $3 $4" | awk '{
+      s = $3-$2; if (s <= 0) s = 1e-3; mb = $4/1048576
+      printf "%-9s %8.1f MB %7.2f s %8.1f MB/s %10.0f pkt/s\n", $1, mb, s, mb/s, $5/s
+   }'
+}
+
+size() {
+   ls -l "$@" | awk '{n += $5} END {print n+0}'
+}
+
+mkdir -p $dir/v3 $dir/v2 $dir/pool || exit 1
+set -e
+set -- `mkstore -M $mb -x 0.001 $dir/v3/taurus_0665_001.store`
+np3=$(($2 + $3))
+set -- `mkstore -2 -M $mb -x 0.001 $dir/v2/taurus_0666_001.store`
+np2=$(($2 + $3))
+
+t=`now`
+tv3mseed -z $dir/z.dat -n $dir/n.dat -e $dir/e.dat $dir/v3/taurus_0665_001.store
+report tv3mseed $t `size $dir/v3/*.store` $np3
+
+t=`now`
+tv2mseed -z $dir/z2.dat -n $dir/n2.dat -e $dir/e2.dat \
+   $dir/v2/taurus_0666_001.store
+report tv2mseed $t `size $dir/v2/*.store` $np2
+
+nr=$((`size $dir/z.dat` / 512))
+t=`now`
+mseedsort $dir/z.dat | sort -k 6 -k 7 -k 8 -k 9 -k 10 -k 11 -k 12 |
+   awk '{print $5}' | mseedsort -o $dir/zs.dat $dir/z.dat
+report sort $t `size $dir/z.dat` $nr
+
+t=`now`
+splitseed -s 1h -d $dir/pool $dir/zs.dat > /dev/null
+report split $t `size $dir/zs.dat` $nr
+
+t=`now`
+ls $dir/pool/* | mseedgap -d > /dev/null
+report gap $t `size $dir/pool/*` $nr
+
+[ -n "$keep" ] || rm -rf $dir
@@ -0,0 +1,100 @@
+#!/bin/sh
+#  dobatch -- shell script to extract the data from many stores at once,
+#            running as many tv3mseed (or tv2mseed) jobs in parallel as the
+#            machine will bear.
+#
+#  usage:  dobatch.sh [-j n] [-m MB] [-f n] [-c] [-v2] manifest
+#
+#  Each line of the manifest describes one store group:
+#     store station network outdir
+#  e.g.
+#     /field/BABY/taurus_0665_001.store BABY YK /data/BABY
+#  Give station or network as - to keep the datalogger's.  Lines starting
+#  with # are ignored.  The Z, N and E data from each store are put in
+#  outdir/z.dat, n.dat and e.dat (z.msz etc. with -c), and messages in
+#  outdir/extract.log; the directory is made if need be.
+#
+#  Options:
+#     -j n - run at most n jobs at once (default: number of CPUs)
+#     -m MB - total memory the jobs may use (default: half of what is free)
+#     -f n - total open files the jobs may use (default: ulimit -n)
+#     -c - write compressed MSEED (tv3mseed -c)
+#     -v2 - stores are Taurus v2 (use tv2mseed)
+#
+#  Jobs are taken from the manifest in order as earlier ones finish.  The
+#  number run at once is the smallest of -j, the memory budget divided by
+#  what one job needs, and the file budget divided by the files one job
+#  holds open.  As each store finishes, a line
+#     done <store> <MB> MB <s> s <MB/s> MB/s
+#  is written (or "FAIL ..." with the log name if the extraction failed),
+#  then a total when all are done.
+
+MEMJOB=16                      # MB per job (1 MB read buffer, output buffers)
+FDJOB=10                       # Files per job (std. I/O, store, outputs)
+
+if [ "$1" = "-run" ]; then
+   # Run one job:  -run <tool> <opts> <sfx> store station network outdir
+   tool=$2 opts=$3 sfx=$4 store=$5 sta=$6 net=$7 dir=$8
+   set --
+   [ "$sta" = "-" ] || set -- "$@" -S "$sta"
+   [ "$net" = "-" ] || set -- "$@" -N "$net"
+   mkdir -p "$dir" || { echo "FAIL $store (can't make $dir)"; exit 0;}
+   size=`ls -l "$(echo $store | sed 's/001\.store$//')"[0-9][0-9][0-9].store \
+      2>/dev/null | awk '{n += $5} END {print n+0}'`
+   t0=`date +%s`
+   if $tool $opts -z "$dir/z.$sfx" -n "$dir/n.$sfx" -e "$dir/e.$sfx" \
+      "$@" "$store" > "$dir/extract.log" 2>&1; then
+      t1=`date +%s`
+      echo "$store $size $t0 $t1" | awk '{
+	 mb = $2/1048576; s = $4-$3; if (s < 1) s = 1
+	 printf "done %s %.1f MB %d s %.1f MB/s\n", $1, mb, $4-$3, mb/s
+      }'
+   else
+      echo "FAIL $store (see $dir/extract.log)"
+   fi
+   exit 0
+fi
+
+jobs=`getconf _NPROCESSORS_ONLN 2>/dev/null || sysctl -n hw.ncpu 2>/dev/null`
+mem= files=`ulimit -n` tool=tv3mseed opts= sfx=dat
+while [ $# -gt 0 ]; do
+   case "$1" in
+      -j) jobs=$2; shift 2;;
+      -m) mem=$2; shift 2;;
+      -f) files=$2; shift 2;;
+      -c) opts=-c sfx=msz; shift;;
+      -v2) tool=tv2mseed; shift;;
+      -*) echo "**Bad option: $1"; exit 1;;
+      *) break;;
+   esac
+done
+[ $# -eq 1 ] && [ -r "$1" ] || {
+   echo "**usage: dobatch.sh [-j n] [-m MB] [-f n] [-c] [-v2] manifest"; exit 1;}
+[ "$tool" = "tv2mseed" ] && [ -n "$opts" ] && {
+   echo "**-c only available with v3 stores"; exit 1;}
+if [ -z "$mem" ]; then
+   mem=`awk '/^MemAvailable:/{print int($2/2048)}' /proc/meminfo 2>/dev/null`
+   [ -n "$mem" ] || mem=1024
+fi
+[ "$files" = "unlimited" ] && files=65536
+
+# Jobs at once limited by CPUs, memory and open files
+n=`echo ${jobs:-1} $mem $files | awk -v m=$MEMJOB -v f=$FDJOB '{
+   n = $1; if (int($2/m) < n) n = int($2/m); if (int($3/f) < n) n = int($3/f)
+   print (n < 1) ? 1 : n
+}'`
+echo "$n jobs at once (${jobs:-1} CPUs, $mem MB, $files files)"
+
+t0=`date +%s`
+grep -v '^#' "$1" | awk 'NF >= 4 {print $1, $2, $3, $4}' |
+   xargs -n 4 -P $n sh "$0" -run $tool "$opts" $sfx |
+   awk -v t0=$t0 '
+      {print; fflush()}
+      $1 == "done" {mb += $3; n++}
+      $1 == "FAIL" {f++}
+      END {
+	 "date +%s" | getline t1; s = t1-t0; if (s < 1) s = 1
+	 printf "total %d stores %.1f MB %d s %.1f MB/s", n, mb, s, mb/s
+	 if (f) printf ", %d failed", f
+	 printf "\n"
+      }'
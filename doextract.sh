@@ -1,11 +1,23 @@
 #! /bin/sh
 #usage:  doextract [-store xxxx yyyy | [-mseed dir] [-sn store#] yyyy mm [dd]]
-#  apollo server must be running on port 8080
+#  apollo server must be running on port 8080, or else NMXD set to the
+#  socket of a running nmxd (which needs no write permission on the store)
 #  xxxx is the store file and yyyy is the station name
 #  store file and mseed dir must be full path names (apollo server has no
 #  working directory)
 #by G. Helffrich/U. Bristol 25 May 2007, updated 14 July 2011
 tmp=/tmp/tmp$$
+if [ "$1" = "-store" -a -n "$NMXD" ]; then
+   if nmxd -c -s $NMXD store $2 $3 ; then
+      echo "**Store selection succeeded."
+      sname=`basename $2`
+      sn=`echo $sname | sed -e 's/.*_\([0-9][0-9][0-9][0-9]\)_.*/\1/'`
+      echo NMXSTORE=$sn NMXSTA=$3 > .nmxstore
+   else
+      echo "**Store selection failed -- nmxd running?"
+   fi
+   exit
+fi
 if [ "$1" = "-store" ]; then
    pfx="http://localhost:8080/pages/central/storeSelector.page"
    sfx="storeFile=$2" sta=$3
@@ -135,6 +147,19 @@ sub getFiles
 getFiles($ip_address, $serialNumber, $startTime, 1, 1, $fn);
 __END__
 }
+if [ -n "$NMXD" ]; then
+function ext() { ## Day's data from nmxd, in time order
+   ## 2: store# 3: yyyy/mm/dd_hh:mm:ss 6: file prefix
+   for c in Z N E ; do
+      if nmxd -c -s $NMXD -o $6.BH$c data $2 $c `echo $3 |
+	 sed -e 's/_.*//' -e 's|/| |g'` ; then
+	 echo "Got file: $6.BH$c"
+      else
+	 /bin/rm -f $6.BH$c ; echo "Error getting $6.BH$c"
+      fi
+   done
+}
+fi
 function rename() { ## Rename files to actual start time of data in them
    ## 1: dir 2: file prefix 3: result
    for c in BHE BHN BHZ ; do
@@ -220,5 +245,6 @@ else
    echo "          extraction"
    echo "       and yyyy mm [dd] - year, month and (optional) day for data"
    echo "          extraction; if no day, all days in month extracted."
-   echo "   An Apollo Lite server must be running on port 8080"
+   echo "   An Apollo Lite server must be running on port 8080, or NMXD be"
+   echo "   set to the socket of a running nmxd"
 fi
@@ -1,9 +1,21 @@
 #! /bin/sh
 #usage:  dogetpos [-p] [-store xxxx yyyy | [-sn store#] yyyy mm [dd]]
-#  apollo server must be running on port 8080
+#  apollo server must be running on port 8080, or else NMXD set to the
+#  socket of a running nmxd (which has no elevation, so gives it as 0)
 #  xxxx is the store file and yyyy is the station name
 #by G. Helffrich/U. Bristol 14 Nov 2007; updated 1 Apr. 2008
 opt_p=0 cont=1
+if [ "$1" = "-store" -a -n "$NMXD" ]; then
+   if nmxd -c -s $NMXD store $2 $3 ; then
+      echo "**Store selection succeeded."
+      sname=`basename $2`
+      sn=`echo $sname | sed -e 's/.*_\([0-9][0-9][0-9][0-9]\)_.*/\1/'`
+      echo NMXSTORE=$sn NMXSTA=$3 > .nmxstore
+   else
+      echo "**Store selection failed -- nmxd running?"
+   fi
+   exit
+fi
 if [ "$1" = "-store" ]; then
    pfx="http://localhost:8080/pages/central/storeSelector.page"
    sfx="storeFile=$2" sta=$3
@@ -40,8 +52,17 @@ while [ $cont -ne 0 ]; do
 done
 yy=$1; mm=`echo $2 | awk '{printf "%02d",$1}'`
 y0=`echo $yy | awk '{printf "%02d",$1%100}'`
+function get() {
+   if [ -n "$NMXD" ]; then  ## First position in the hour from nmxd
+      nmxd -c -s $NMXD pos ${2} ${3}/${4}/${5}T${6}:${7}:${8} \
+	 ${3}/${4}/${5}T${6}:59:59 |
+	 awk 'NR==1{print "Latitude:", $3; print "Longitude:", $4; print "Elevation: 0"}'
+   else
+      curl -sS "http://${1}/playback/download?channels=taurus_${2}/band/timeSeries1/&dataType=TimeSeries&dataFormat=ASCII&startTime=${3}-${4}-${5} ${6}:${7}:${8}&duration=1 s" | sed -e 's///g'
+   fi
+}
 function ext() {
-   curl -sS "http://${1}/playback/download?channels=taurus_${2}/band/timeSeries1/&dataType=TimeSeries&dataFormat=ASCII&startTime=${3}-${4}-${5} ${6}:${7}:${8}&duration=1 s" | sed -e 's///g' |
+   get $* |
    awk 'BEGIN{reftek='"${opt_p}"'}
       func dms(val,n,p,m){
 	 if (val<0) {sfx=m; val=-val} else sfx=p
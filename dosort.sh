@@ -5,19 +5,25 @@
 #
 #  Reads file names from standard input.
 #  Single command line arg is output directory.  Does not destroy any input
-#     file.  Renames file to correspond to first sample time.
+#     file.  Renames file to correspond to first sample time.  Renaming is
+#     done by a single rnmseed process reading the sorted file names as they
+#     are produced, rather than by a mseedtime/awk/mv per file.  A sorted
+#     file whose name is already taken by another file is removed, with a
+#     warning, rather than left behind in the output directory.
 
-tmp=/tmp/tmp$$.msd dir=${1:-.} blk=${2:-4096}
+dir=${1:-.} blk=${2:-4096} n=0
 
 while read f; do
+   n=$((n + 1)) tmp=${dir}/tmp$$.$n.msd
    mseedsort -b ${blk} $f |
       sort -k 6 -k 7 -k 8 -k 9 -k 10 -k 11 -k 12 |
       awk '{print $5}' |
       mseedsort -b ${blk} -o $tmp $f
-#02697 -- BHZ YY 2012 01 04 00 00 09 2000
-   fn=`mseedtime $tmp |
-      awk '{yr=substr($5,3)
-         printf "%s%s%s%s%s%s%s.%s",$1,yr,$6,$7,$8,$9,$(10),$3}'`
-   mv $tmp ${dir}/$fn
+   echo $tmp
+done | rnmseed -b ${blk} -new -rn
+
+for f in ${dir}/tmp$$.*.msd; do
+   [ -f "$f" ] || continue
+   echo "dosort: $f not renamed (name in use), removed" >&2
+   rm -f "$f"
 done
-/bin/rm -f $tmp
@@ -0,0 +1,441 @@
+/* Read files from an ext2 file system image or block device without
+   mounting it.
+
+   Taurus data media carry an ext2 file system.  Rather than mounting it
+   (which needs FUSE or a loop device, root, and often an fsck first), the
+   file system is read directly:  the superblock, the group descriptors, and
+   the inode of the file wanted, found by its path from the root directory
+   or, for a name without a directory part, by searching the directory tree
+   for it.  The inode's block lists (direct and indirect, or ext4 extents)
+   are gathered into runs of blocks contiguous on the disk, and the file is
+   read ahead a megabyte at a time with pread(2), one call per run.  A store
+   file laid down in contiguous blocks, as the Taurus writes them, is thus
+   read in large sequential transfers at the device's speed.  Files are
+   returned as read-only stdio streams, so the reading program needn't know
+   where they come from.
+
+   All file system values are little-endian.  Only what is needed to read
+   regular files is decoded; a journal needing recovery is ignored.
+
+   G. Helffrich/U. Bristol
+      18 Oct. 2026
+*/
+
+#define _GNU_SOURCE                /* For fopencookie */
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include "ext2.h"
+
+#define E2MAGIC 0xEF53             /* Superblock magic */
+#define E2EXTM 0xF30A              /* Extent tree header magic */
+#define E2ROOT 2                   /* Root directory inode */
+#define E2FEXT 0x80000             /* Inode flag:  uses extents */
+#define E2INCO 0x2c6               /* Incompatible features understood */
+#define E264B 0x80                 /* Incompatible feature:  64 bit */
+#define E2DEPTH 32                 /* Deepest directory searched */
+#define E2XDEP 5                   /* Deepest extent tree */
+#define E2BUF 0x100000             /* Read-ahead window size */
+#define E2SBUF 512                 /* Stream buffer size (about a packet) */
+
+struct e2fs {
+   int fd;
+   uint32_t bsiz, isiz, ipg, ngrp, dsiz;
+   unsigned char *gdt;             /* Group descriptor table */
+};
+
+struct run {                       /* Blocks contiguous on the disk */
+   uint64_t lblk, pblk, n;
+};
+
+struct e2f {
+   struct e2fs *fs;
+   struct run *run;
+   int nrun, mrun;
+   uint64_t size, pos;
+   char *win;                      /* Read-ahead window */
+   uint64_t woff;                  /* File offset of window and its length */
+   size_t wlen;
+};
+
+static uint32_t le16(unsigned char *p){
+   return p[0] | p[1] << 8;
+}
+
+static uint32_t le32(unsigned char *p){
+   return p[0] | p[1] << 8 | p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+static int rdat(struct e2fs *fs, uint64_t off, void *buf, size_t n){
+   return n == pread(fs->fd, buf, n, (off_t)off) ? 0 : -1;
+}
+
+/* Read inode ino's first 128 bytes */
+
+static int rdino(struct e2fs *fs, uint32_t ino, unsigned char *buf){
+   uint32_t g, i;
+   unsigned char *gd;
+   uint64_t tbl;
+
+   if (ino == 0 || (g = (ino-1) / fs->ipg) >= fs->ngrp) return -1;
+   i = (ino-1) % fs->ipg;
+   gd = fs->gdt + (size_t)g*fs->dsiz;
+   tbl = le32(gd+8);
+   if (fs->dsiz >= 64) tbl |= (uint64_t)le32(gd+0x28) << 32;
+   return rdat(fs, tbl*fs->bsiz + (uint64_t)i*fs->isiz, buf, 128);
+}
+
+/* Open the file system on dev; returns NULL if it isn't ext2 (or ext3/4
+   without features that are not understood) */
+
+struct e2fs *e2mount(char *dev){
+   unsigned char sb[1024];
+   struct e2fs *fs = calloc(1, sizeof(struct e2fs));
+   uint64_t nblk, first;
+   uint32_t bpg;
+
+   if (fs == NULL) return NULL;
+   fs->fd = open(dev, O_RDONLY);
+   if (fs->fd < 0) goto bad;
+   if (rdat(fs, 1024, sb, sizeof(sb)) || le16(sb+56) != E2MAGIC) goto bad;
+   if (le32(sb+96) & ~E2INCO) goto bad;
+   fs->bsiz = 1024 << le32(sb+24);
+   fs->isiz = le32(sb+76) ? le16(sb+88) : 128;
+   fs->dsiz = (le32(sb+96) & E264B) ? le16(sb+254) : 32;
+   fs->ipg = le32(sb+40);
+   bpg = le32(sb+32);
+   nblk = le32(sb+4);
+   if (le32(sb+96) & E264B) nblk |= (uint64_t)le32(sb+336) << 32;
+   first = le32(sb+20);
+   if (fs->bsiz > 65536 || fs->isiz < 128 || fs->dsiz < 32 || !fs->ipg || !bpg)
+      goto bad;
+   fs->ngrp = (nblk - first + bpg - 1) / bpg;
+   fs->gdt = malloc((size_t)fs->ngrp * fs->dsiz);
+   if (fs->gdt == NULL ||
+       rdat(fs, (first+1)*fs->bsiz, fs->gdt, (size_t)fs->ngrp*fs->dsiz))
+      goto bad;
+   return fs;
+
+bad:
+   if (fs->fd >= 0) close(fs->fd);
+   free(fs);
+   return NULL;
+}
+
+/* Add n blocks starting at logical block lblk, physical block pblk, to the
+   file's block map, extending the last run if they follow on from it */
+
+static int addrun(struct e2f *f, uint64_t lblk, uint64_t pblk, uint64_t n){
+   struct run *r = f->nrun ? f->run + f->nrun-1 : NULL;
+
+   if (r && r->lblk + r->n == lblk && r->pblk + r->n == pblk) {
+      r->n += n;
+      return 0;
+   }
+   if (f->nrun >= f->mrun) {
+      f->mrun = f->mrun ? 2*f->mrun : 16;
+      r = realloc(f->run, f->mrun*sizeof(struct run));
+      if (r == NULL) return -1;
+      f->run = r;
+   }
+   r = f->run + f->nrun++;
+   r->lblk = lblk; r->pblk = pblk; r->n = n;
+   return 0;
+}
+
+/* Map block blk, holding block pointers to lev levels of indirection, or a
+   data block if lev is zero.  *lb is the logical block reached, nb the
+   number of blocks in the file.  Holes are left out of the map. */
+
+static int blkmap(struct e2f *f, uint32_t blk, int lev, uint64_t *lb,
+   uint64_t nb
+){
+   uint64_t span = 1;
+   uint32_t i, np = f->fs->bsiz / 4;
+   unsigned char *b;
+   int rc = 0;
+
+   for(i=0; i<lev; i++) span *= np;
+   if (*lb >= nb) return 0;
+   if (blk == 0) {
+      *lb += span;
+      return 0;
+   }
+   if (lev == 0) {
+      *lb += 1;
+      return addrun(f, *lb-1, blk, 1);
+   }
+   if ((b = malloc(f->fs->bsiz)) == NULL) return -1;
+   if (rdat(f->fs, (uint64_t)blk*f->fs->bsiz, b, f->fs->bsiz)) rc = -1;
+   for(i=0; rc == 0 && i<np && *lb<nb; i++)
+      rc = blkmap(f, le32(b+4*i), lev-1, lb, nb);
+   free(b);
+   return rc;
+}
+
+/* Map the extent tree node at h (an inode's i_block or a tree block), which
+   has room for nmax entries and may have at most lev levels below it */
+
+static int extmap(struct e2f *f, unsigned char *h, int nmax, int lev){
+   int i, n = le16(h+2), depth = le16(h+6), rc = 0;
+   unsigned char *b;
+
+   if (le16(h) != E2EXTM || n > nmax || depth > lev) return -1;
+   for(i=0; rc == 0 && i<n; i++) {
+      unsigned char *e = h + 12 + 12*i;
+      if (depth == 0) {
+         uint32_t len = le16(e+4);
+	 uint64_t p = (uint64_t)le16(e+6) << 32 | le32(e+8);
+	 if (len <= 32768)         /* Longer are unwritten, read as zeros */
+	    rc = addrun(f, le32(e), p, len);
+      } else {
+	 uint64_t p = (uint64_t)le16(e+8) << 32 | le32(e+4);
+	 if ((b = malloc(f->fs->bsiz)) == NULL) return -1;
+	 rc = rdat(f->fs, p*f->fs->bsiz, b, f->fs->bsiz);
+	 if (rc == 0) rc = extmap(f, b, (f->fs->bsiz-12)/12, depth-1);
+	 free(b);
+      }
+   }
+   return rc;
+}
+
+/* Make a file handle for inode ino, with its block map */
+
+static struct e2f *e2file(struct e2fs *fs, uint32_t ino){
+   unsigned char in[128];
+   struct e2f *f;
+   uint64_t lb = 0, nb;
+   int i, rc = 0;
+
+   if (rdino(fs, ino, in)) return NULL;
+   if ((f = calloc(1, sizeof(struct e2f))) == NULL) return NULL;
+   f->fs = fs;
+   f->size = le32(in+4);
+   if ((le16(in) & 0xf000) == 0x8000) f->size |= (uint64_t)le32(in+108) << 32;
+   nb = (f->size + fs->bsiz - 1) / fs->bsiz;
+   if (le32(in+32) & E2FEXT)
+      rc = extmap(f, in+40, 4, E2XDEP);
+   else {
+      for(i=0; rc == 0 && i<12; i++) rc = blkmap(f, le32(in+40+4*i), 0, &lb, nb);
+      for(i=1; rc == 0 && i<=3; i++) rc = blkmap(f, le32(in+84+4*i), i, &lb, nb);
+   }
+   if (rc) {
+      free(f->run); free(f);
+      return NULL;
+   }
+   return f;
+}
+
+/* Read n bytes from file offset pos; blocks in no run are holes */
+
+static ssize_t rdrun(struct e2f *f, uint64_t pos, char *buf, size_t n){
+   size_t got = 0, bs = f->fs->bsiz;
+
+   while (got < n && pos < f->size) {
+      uint64_t lb = pos / bs, o = pos % bs, k = n - got, rem;
+      int lo = 0, hi = f->nrun;
+      struct run *r;
+
+      while (lo < hi) {            /* First run ending after lb */
+	 int mid = (lo + hi) / 2;
+	 if (f->run[mid].lblk + f->run[mid].n > lb) hi = mid; else lo = mid+1;
+      }
+      r = lo < f->nrun ? f->run + lo : NULL;
+      if (k > f->size - pos) k = f->size - pos;
+      if (r && r->lblk <= lb) {
+	 ssize_t m;
+	 rem = (r->lblk + r->n - lb)*bs - o;
+	 if (k > rem) k = rem;
+	 m = pread(f->fs->fd, buf+got, k, (off_t)((r->pblk + lb - r->lblk)*bs + o));
+	 if (m <= 0) return got ? (ssize_t)got : -1;
+	 k = m;
+      } else {
+	 if (r && k > (rem = (r->lblk - lb)*bs - o)) k = rem;
+	 memset(buf+got, 0, k);
+      }
+      got += k; pos += k;
+   }
+   return got;
+}
+
+/* Read from the file's current position, through the read-ahead window.
+   The stream's own buffer is kept small:  stdio discards it on every seek,
+   which the store reader does between packets. */
+
+static ssize_t fread2(struct e2f *f, char *buf, size_t n){
+   size_t got = 0, k;
+   ssize_t m;
+
+   while (got < n && f->pos < f->size) {
+      if (f->pos < f->woff || f->pos >= f->woff + f->wlen) {
+	 if (n - got >= E2BUF) {
+	    m = rdrun(f, f->pos, buf+got, n-got);
+	    if (m <= 0) break;
+	    got += m; f->pos += m;
+	    continue;
+	 }
+	 f->woff = f->pos - f->pos % f->fs->bsiz;
+	 m = rdrun(f, f->woff, f->win, E2BUF);
+	 f->wlen = m > 0 ? m : 0;
+	 if (f->pos >= f->woff + f->wlen) break;
+      }
+      k = f->woff + f->wlen - f->pos;
+      if (k > n - got) k = n - got;
+      memcpy(buf+got, f->win + (f->pos - f->woff), k);
+      got += k; f->pos += k;
+   }
+   return got || f->pos >= f->size ? (ssize_t)got : -1;
+}
+
+static int64_t fseek2(struct e2f *f, int64_t off, int whence){
+   if (whence == SEEK_CUR) off += f->pos;
+   if (whence == SEEK_END) off += f->size;
+   if (off < 0) return -1;
+   return f->pos = off;
+}
+
+static int fclose2(void *cookie){
+   struct e2f *f = cookie;
+   free(f->run); free(f->win); free(f);
+   return 0;
+}
+
+#if defined(__APPLE__) || defined(__FreeBSD__)
+static int frd(void *cookie, char *buf, int size){
+   return fread2(cookie, buf, size);
+}
+
+static fpos_t fsk(void *cookie, fpos_t off, int whence){
+   return fseek2(cookie, off, whence);
+}
+#else
+static ssize_t frd(void *cookie, char *buf, size_t size){
+   return fread2(cookie, buf, size);
+}
+
+static int fsk(void *cookie, off64_t *off, int whence){
+   int64_t pos = fseek2(cookie, *off, whence);
+   if (pos < 0) return -1;
+   *off = pos;
+   return 0;
+}
+#endif
+
+/* Read all of a directory (or any file) into memory */
+
+static unsigned char *rdall(struct e2fs *fs, uint32_t ino, size_t *n){
+   struct e2f *f = e2file(fs, ino);
+   unsigned char *b;
+
+   if (f == NULL) return NULL;
+   b = malloc(f->size ? f->size : 1);
+   if (b && f->size != rdrun(f, 0, (char *)b, f->size)) {
+      free(b); b = NULL;
+   }
+   *n = f->size;
+   fclose2(f);
+   return b;
+}
+
+static int isdir(struct e2fs *fs, uint32_t ino){
+   unsigned char in[128];
+   return 0 == rdino(fs, ino, in) && (le16(in) & 0xf000) == 0x4000;
+}
+
+/* Look up name (len characters) in directory dir, or anywhere below it if
+   lev is not negative; returns its inode, or 0 if not found */
+
+static uint32_t lookup(struct e2fs *fs, uint32_t dir, char *name, int len,
+   int lev
+){
+   size_t n, i;
+   uint32_t ino = 0;
+   unsigned char *b = rdall(fs, dir, &n), *e;
+
+   if (b == NULL) return 0;
+   for(i=0; ino == 0 && i+8 <= n; i += le16(e+4)) {
+      e = b+i;
+      if (le16(e+4) < 8) break;
+      if (le32(e) && e[6] == len && 0 == memcmp(e+8, name, len))
+	 ino = le32(e);
+   }
+   for(i=0; lev >= 0 && lev < E2DEPTH && ino == 0 && i+8 <= n; i += le16(e+4)) {
+      e = b+i;
+      if (le16(e+4) < 8) break;
+      if (le32(e) == 0 || (e[6] == 1 && e[8] == '.') ||
+	  (e[6] == 2 && e[8] == '.' && e[9] == '.'))
+	 continue;
+      if (e[7] == 2 || (e[7] == 0 && isdir(fs, le32(e))))
+	 ino = lookup(fs, le32(e), name, len, lev+1);
+   }
+   free(b);
+   return ino;
+}
+
+/* Find the inode of a file by its path from the root, or by searching the
+   directory tree for it if it has no directory part */
+
+static uint32_t namei(struct e2fs *fs, char *name){
+   uint32_t ino = E2ROOT;
+   char *p = name, *q;
+
+   if (NULL == strchr(name, '/'))
+      return lookup(fs, E2ROOT, name, strlen(name), 0);
+   for(; ino && *p; p = q) {
+      while (*p == '/') p++;
+      for(q = p; *q && *q != '/'; q++);
+      if (q > p) ino = lookup(fs, ino, p, q-p, -1);
+   }
+   return ino;
+}
+
+/* Open a file in the file system for reading */
+
+FILE *e2open(struct e2fs *fs, char *name){
+   uint32_t ino = namei(fs, name);
+   struct e2f *f = ino ? e2file(fs, ino) : NULL;
+   FILE *fd;
+
+   if (f == NULL) return NULL;
+   if ((f->win = malloc(E2BUF)) == NULL) {
+      fclose2(f);
+      return NULL;
+   }
+#if defined(__APPLE__) || defined(__FreeBSD__)
+   fd = funopen(f, frd, NULL, fsk, fclose2);
+#else
+   {
+      cookie_io_functions_t io = {frd, NULL, fsk, fclose2};
+      fd = fopencookie(f, "r", io);
+   }
+#endif
+   if (fd == NULL)
+      fclose2(f);
+   else
+      (void)setvbuf(fd, NULL, _IOFBF, E2SBUF);
+   return fd;
+}
+
+/* Like stat(2), for a file in the file system:  sets its mode, size and
+   times */
+
+int e2stat(struct e2fs *fs, char *name, struct stat *sb){
+   unsigned char in[128];
+   uint32_t ino = namei(fs, name);
+
+   if (ino == 0 || rdino(fs, ino, in)) return -1;
+   memset(sb, 0, sizeof(*sb));
+   sb->st_ino = ino;
+   sb->st_mode = le16(in);
+   sb->st_size = le32(in+4);
+   if ((sb->st_mode & 0xf000) == 0x8000)
+      sb->st_size |= (off_t)le32(in+108) << 32;
+   sb->st_atime = le32(in+8);
+   sb->st_ctime = le32(in+12);
+   sb->st_mtime = le32(in+16);
+   return 0;
+}
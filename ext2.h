@@ -0,0 +1,15 @@
+/* Declarations for ext2.c, reading files from ext2 file system images.
+
+   G. Helffrich/U. Bristol
+      18 Oct. 2026
+*/
+
+#include <stdio.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+struct e2fs;
+
+struct e2fs *e2mount(char *dev);
+FILE *e2open(struct e2fs *fs, char *name);
+int e2stat(struct e2fs *fs, char *name, struct stat *sb);
@@ -0,0 +1,470 @@
+/* Make a synthetic Taurus store, for testing and timing the store readers
+   and the tools downstream of them.
+
+   G. Helffrich/U. Bristol
+      18 Oct. 2026
+
+Usage:  mkstore {-h | -2 | -3 | -H <hours> | -M <MB> | -F <MB> | -r <sps> |
+                 -c <n> | -t <time> | -i <s/n> | -x <frac> | -d <frac> | -s <seed>} ...
+                 <store>
+
+Command line parameters:
+   -h - usage (this text)
+   -2, -3 - make a Taurus v2 or v3 (default) store
+   -H <hours> - length of data in the store (default 24)
+   -M <MB> - instead, make data until the store is this size
+   -F <MB> - largest store file size; the store is split into as many
+      NNN.store files as needed (default 1024)
+   -r <sps> - sample rate (default 100)
+   -c <n> - number of data channels, 3 or 6 (default 3).  The second
+      sensor of a 6-channel v3 store is in bands 73, 75 and 77.
+   -t <time> - time of first sample, yyyy/mm/dd[Thh:mm[:ss]]
+      (default 2013/01/01)
+   -i <s/n> - Taurus serial number (default 665)
+   -x <frac> - fraction of packets written out of time order (default 0)
+   -d <frac> - fraction of packets written twice (default 0)
+   -s <seed> - random number seed (default 1)
+   <store> - name of the first store file, which must end in "001.store";
+      the rest of the store's file names are derived from this.
+
+   The store holds Z, N and E data packets (bands 65, 67, 69 in v3; 0x89,
+   0x8b, 0x8d in v2) of Steim-1 compressed data, with SOH packets (band 71 or
+   0x99) every minute giving temperature, mass positions and supply voltage.
+   Packets are put in CLUS sections listed in the store's VOLFALOC table,
+   after CHTB and CSTB sections (which have nothing in them).  The data are
+   a sinusoid plus noise; each sample depends only on the seed, component and
+   sample number, so the same options always make the same store.  A line
+
+      packets <data> <soh> bytes <size> files <n> samples <per component>
+
+   is written on the standard output when done.
+*/
+
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include "msrec.h"
+
+#define HDRSIZ 36                  /* Store file volume header */
+#define SECHDR 68                  /* Section header */
+#define CLUSIZ 0x10000             /* Packet space in a CLUS section */
+#define MAXPKT 512                 /* Largest packet made */
+#define SOHDT 60                   /* SOH packet interval (s) */
+
+char *prog;
+
+#define MAXC 6                     /* Most data channels */
+
+int vers = 3, iid = 665, srf = 100, srm = 1, nc = 3;
+double hours = 24, fmb = 1024, smb = 0, xfrac = 0, dfrac = 0;
+uint64_t seed = 1, t0;
+
+void usage(){
+   char *msg =
+   " {-h | -2 | -3 | -H <hours> | -M <MB> | -F <MB> | -r <sps> |\n"
+   "        -c <n> | -t <time> | -i <s/n> | -x <frac> | -d <frac> | -s <seed>} ...\n"
+   "        <store>\n"
+   " Options:\n"
+   "   -h - usage (this text)\n"
+   "   -2, -3 - make a Taurus v2 or v3 (default) store\n"
+   "   -H <hours> - length of data in store (default 24)\n"
+   "   -M <MB> - instead, make data until store is this size\n"
+   "   -F <MB> - largest store file size (default 1024)\n"
+   "   -r <sps> - sample rate (default 100)\n"
+   "   -c <n> - number of data channels, 3 or 6 (default 3)\n"
+   "   -t <time> - first sample time, yyyy/mm/dd[Thh:mm[:ss]]\n"
+   "      (default 2013/01/01)\n"
+   "   -i <s/n> - Taurus serial number (default 665)\n"
+   "   -x <frac> - fraction of packets out of time order (default 0)\n"
+   "   -d <frac> - fraction of packets duplicated (default 0)\n"
+   "   -s <seed> - random number seed (default 1)\n"
+   "   <store> - first store file name, ending in 001.store\n";
+   fprintf(stderr, "Usage: %s%s", prog, msg);
+   fflush(stderr);
+}
+
+void err(char *msg){
+   fprintf(stderr, "%s: %s\n", prog, msg); fflush(stderr);
+   exit(1);
+}
+
+void phw(unsigned char *p, int v){
+   p[1] = v         & 0xff; p[0] = (v >> 8)  & 0xff;
+}
+
+void pfw(unsigned char *p, int v){
+   p[3] = v         & 0xff; p[2] = (v >> 8)  & 0xff;
+   p[1] = (v >> 16) & 0xff; p[0] = (v >> 24) & 0xff;
+}
+
+void pdw(unsigned char *p, uint64_t v){
+   pfw(p, v >> 32); pfw(p+4, v);
+}
+
+/* Random numbers that depend only on their arguments (splitmix64) */
+
+uint64_t mix(uint64_t a, uint64_t b){
+   uint64_t z = seed + a*0x9e3779b97f4a7c15ull + b*0xbf58476d1ce4e5b9ull;
+   z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+   z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+   return z ^ (z >> 31);
+}
+
+double unif(uint64_t a, uint64_t b){
+   return (mix(a, b) >> 11) * (1.0/9007199254740992.0);
+}
+
+/* Samples are a sinusoid (a different period for each component, from a
+   table of one period) plus noise */
+
+int *sine[MAXC], nsine[MAXC];
+
+void mksine(){
+   int c, k;
+   for(c=0; c<nc; c++) {
+      nsine[c] = (int)((double)srf*srm*(17+3*c));
+      sine[c] = malloc(nsine[c]*sizeof(int));
+      if (sine[c] == NULL) err("out of memory");
+      for(k=0; k<nsine[c]; k++) sine[c][k] = 2000*sin(2*M_PI*k/nsine[c]);
+   }
+}
+
+int sample(int c, int64_t k){
+   return sine[c][k % nsine[c]] + (int)(mix(c, k) % 257) - 128;
+}
+
+/* Steim-1 compress samples of component c starting at k into 7 frames.
+   Returns number of samples packed. */
+
+#define MAXSMP (7*15*4)            /* Most samples in 7 frames */
+
+int steim1(unsigned char *out, int c, int64_t k){
+   int x[MAXSMP+4], f, w, n = 0, d[4], j, nd, sz;
+   uint32_t ctl, word;
+
+   /* x[0] is sample before the first */
+   for(j=0; j<MAXSMP+4; j++) x[j] = (k+j > 0) ? sample(c, k+j-1) : 0;
+   memset(out, 0, 7*64);
+   pfw(out+4, x[1]);
+   for(f=0; f<7; f++) {
+      ctl = 0;
+      for(w = (f == 0 ? 3 : 1); w < 16; w++) {
+         /* Pack as many differences as fit: 4 bytes, 2 halfwords or a word */
+         for(j=0; j<4; j++) d[j] = x[n+j+1] - x[n+j];
+	 if (d[0] >= -128 && d[0] < 128 && d[1] >= -128 && d[1] < 128 &&
+	     d[2] >= -128 && d[2] < 128 && d[3] >= -128 && d[3] < 128) {
+	    nd = 4, sz = 1;
+	    word = (d[0] & 0xff) << 24 | (d[1] & 0xff) << 16 |
+	           (d[2] & 0xff) << 8 | (d[3] & 0xff);
+	 } else if (d[0] >= -32768 && d[0] < 32768 &&
+	            d[1] >= -32768 && d[1] < 32768) {
+	    nd = 2, sz = 2;
+	    word = (d[0] & 0xffff) << 16 | (d[1] & 0xffff);
+	 } else {
+	    nd = 1, sz = 3;
+	    word = d[0];
+	 }
+	 ctl |= (uint32_t)sz << 2*(15-w);
+	 pfw(out+64*f+4*w, word);
+	 n += nd;
+      }
+      pfw(out+64*f, ctl);
+   }
+   pfw(out+8, x[n]);               /* Reverse integration constant */
+   return n;
+}
+
+/* Packet makers.  Return packet size. */
+
+int datpkt(unsigned char *p, int c, uint64_t tns, int64_t k, int *nsamp){
+   int off;
+
+   memset(p, 0, MAXPKT);
+   if (vers == 3) {
+      p[0] = 'n'; p[1] = 'p';
+      pdw(p+8, tns);
+      pfw(p+16, 51450000); pfw(p+20, -2600000);
+      phw(p+25, iid); p[28] = 2;
+      p[27] = c < 3 ? 65+2*c : 73+2*(c-3); p[29] = p[27]-56;
+      off = 30;
+      phw(p+off, 0x01c8); p[off+4] = srf; p[off+5] = srm;
+      *nsamp = steim1(p+off+8, c, k);
+      phw(p+off+6, *nsamp);
+      off += 8 + 7*64;
+   } else {
+      p[0] = 'N'; p[1] = 'P';
+      pdw(p+12, tns);
+      pfw(p+20, 51450000); pfw(p+24, -2600000); phw(p+28, 60);
+      phw(p+32, iid); p[34] = 0x89+2*c;
+      off = 37;
+      p[off+3] = 0x83; phw(p+off+4, 8); phw(p+off+12, srf*srm);
+      *nsamp = steim1(p+off+14, c, k);
+      phw(p+off+8, *nsamp);
+      off += 14 + 7*64;
+   }
+   phw(p+2, off);
+   return off;
+}
+
+int sohpkt(unsigned char *p, uint64_t tns, int64_t n){
+   union { unsigned int fw; float fl; } u;
+   int off, i;
+
+   memset(p, 0, MAXPKT);
+   if (vers == 3) {
+      p[0] = 'n'; p[1] = 'p';
+      pdw(p+8, tns);
+      pfw(p+16, 51450000); pfw(p+20, -2600000);
+      phw(p+25, iid); p[27] = 71; p[28] = 7; p[29] = 25;
+      off = 30;
+      phw(p+off, 24); phw(p+off+2, 0x012b);      /* Supply voltage */
+      phw(p+off+19, 12000 + n%7);
+      off += 24;
+      phw(p+off, 16); phw(p+off+2, 0x0127);      /* Temperature */
+      u.fl = 21.5 + 0.01*(n%100); pfw(p+off+7, u.fw);
+      off += 16;
+      phw(p+off, 36); phw(p+off+2, 0x0192);      /* Mass positions */
+      for(i=0; i<3; i++) {u.fl = 0.1*(i+1); pfw(p+off+9+9*i, u.fw);}
+      off += 36;
+   } else {
+      p[0] = 'N'; p[1] = 'P';
+      pdw(p+12, tns);
+      pfw(p+20, 51450000); pfw(p+24, -2600000); phw(p+28, 60);
+      phw(p+32, iid); p[34] = 0x99;
+      off = 37;
+      phw(p+off, 80); phw(p+off+2, 0xa781);      /* Temp., mass positions */
+      u.fl = 21.5 + 0.01*(n%100); pfw(p+off+9, u.fw);
+      for(i=0; i<3; i++) {u.fl = 0.1*(i+1); pfw(p+off+0x36+9*i, u.fw);}
+      off += 80;
+      phw(p+off, 24); phw(p+off+2, 0xab81);      /* Supply voltage */
+      phw(p+off+0x15, 12000 + n%7);
+      off += 24;
+   }
+   phw(p+2, off);
+   return off;
+}
+
+/* Store writing.  Sections are made twice: the first time only their sizes
+   are recorded, to size the allocation table; the second time they are
+   written. */
+
+struct sect {
+   uint64_t goff;                  /* Global offset */
+   int fno;                        /* Store file number */
+   size_t siz;
+} *sec = NULL;
+int nsec = 0, msec = 0, isec, wrt = 0;
+
+FILE *sfd = NULL;
+char *store;
+int six, nfile;
+uint64_t ssize;                    /* Total bytes in store files */
+
+unsigned char clus[SECHDR+CLUSIZ+40];
+size_t nclus = 0;
+
+void opnstore(int fno){
+   unsigned char hdr[HDRSIZ];
+   char *name = strdup(store);
+
+   if (sfd && fclose(sfd)) err("error writing store file");
+   sprintf(name+six, "%03d.store", fno);
+   sfd = fopen(name, "w");
+   if (sfd == NULL) err("can't make store file");
+   free(name);
+   if (fno > 1) {
+      memset(hdr, 0, sizeof(hdr));
+      memcpy(hdr, "NMXV", 4); pfw(hdr+4, fno);
+      if (1 != fwrite(hdr, sizeof(hdr), 1, sfd)) err("error writing store file");
+   }
+}
+
+void section(char *type, unsigned char *body, size_t len){
+   unsigned char hdr[SECHDR];
+
+   if (!wrt) {
+      if (nsec >= msec) {
+         msec = msec ? 2*msec : 256;
+	 sec = realloc(sec, msec*sizeof(struct sect));
+	 if (sec == NULL) err("out of memory");
+      }
+      sec[nsec++].siz = SECHDR + len;
+      return;
+   }
+   if (isec > 0 && sec[isec].fno != sec[isec-1].fno) opnstore(sec[isec].fno);
+   memset(hdr, 0, sizeof(hdr));
+   memcpy(hdr+36, type, 4); pfw(hdr+40, len);
+   if (1 != fwrite(hdr, sizeof(hdr), 1, sfd) ||
+       (len && 1 != fwrite(body, len, 1, sfd))) err("error writing store file");
+   isec++;
+}
+
+void endclus(){
+   if (nclus == 0) return;
+   memcpy(clus+nclus, "ENDODATA", 8); memset(clus+nclus+8, 0, 32);
+   section("CLUS", clus, nclus+40);
+   nclus = 0;
+}
+
+void putpkt(unsigned char *p, int siz){
+   int pad = (4 - (siz & 3)) & 3;
+   if (nclus + siz + pad > CLUSIZ) endclus();
+   memcpy(clus+nclus, p, siz); memset(clus+nclus+siz, 0, pad);
+   nclus += siz + pad;
+}
+
+/* Lay out sections in store files and write allocation table */
+
+void layout(){
+   unsigned char *tbl;
+   size_t tsiz = 48 + 16*nsec, fmax = fmb*1048576, fsiz;
+   uint64_t base = 0;
+   int i, fno = 1;
+
+   fsiz = tsiz;
+   for(i=0; i<nsec; i++) {
+      if (fsiz > (fno > 1 ? HDRSIZ : tsiz) && fsiz + sec[i].siz > fmax) {
+         /* Next file; global offsets count all but the header of each */
+	 base += fsiz - HDRSIZ; fno++; fsiz = HDRSIZ;
+      }
+      sec[i].fno = fno; sec[i].goff = base + fsiz;
+      fsiz += sec[i].siz;
+   }
+   nfile = fno;
+   ssize = tsiz + HDRSIZ*(nfile-1);
+   for(i=0; i<nsec; i++) ssize += sec[i].siz;
+
+   tbl = calloc(1, tsiz);
+   if (tbl == NULL) err("out of memory");
+   memcpy(tbl, "NMXV", 4); memcpy(tbl+32, "VOLFALOC", 8);
+   pfw(tbl+40, nsec); pfw(tbl+44, tsiz);
+   for(i=0; i<nsec; i++) {
+      pdw(tbl+48+16*i+4, sec[i].goff);
+      pfw(tbl+48+16*i+12, sec[i].siz);
+   }
+   opnstore(1);
+   if (1 != fwrite(tbl, tsiz, 1, sfd)) err("error writing store file");
+   free(tbl);
+}
+
+/* Make the store's contents */
+
+uint64_t ndat, nsoh, nsmp;
+
+void make(){
+   unsigned char pkt[MAXPKT], held[MAXPKT], empty[64];
+   uint64_t tc[MAXC], tsoh = t0, tend = t0 + (uint64_t)(hours*3600e9), bytes;
+   int64_t kc[MAXC] = {0}, n = 0;
+   double rate = (double)srf*srm;
+   int c, j, siz, hsiz = 0, ns;
+
+   memset(empty, 0, sizeof(empty));
+   section("CHTB", empty, sizeof(empty));
+   section("CSTB", empty, sizeof(empty));
+   ndat = nsoh = 0; bytes = 48;
+   for(c=0; c<nc; c++) tc[c] = t0;
+   for(;;) {
+      if (smb > 0 ? bytes >= smb*1048576 : tc[0] >= tend) break;
+      for(c=0, j=1; j<nc; j++) if (tc[j] < tc[c]) c = j;
+      if (tsoh <= tc[c]) {
+         siz = sohpkt(pkt, tsoh, nsoh++);
+	 tsoh += SOHDT*1000000000ull;
+      } else {
+	 siz = datpkt(pkt, c, tc[c], kc[c], &ns);
+	 kc[c] += ns; tc[c] = t0 + (uint64_t)(1e9*kc[c]/rate + 0.5);
+	 ndat++;
+      }
+      /* Hold a packet back to put it out of order, or repeat it */
+      if (hsiz) {
+         putpkt(pkt, siz); putpkt(held, hsiz); hsiz = 0;
+      } else if (unif(1, n) < xfrac) {
+         memcpy(held, pkt, siz); hsiz = siz;
+      } else
+         putpkt(pkt, siz);
+      if (unif(2, n) < dfrac) putpkt(pkt, siz);
+      bytes += siz;
+      n++;
+   }
+   if (hsiz) putpkt(held, hsiz);
+   endclus();
+   nsmp = kc[0];
+}
+
+int main(int argc, char *argv[]){
+   int i;
+   char *p;
+   int64_t t;
+
+   prog = argv[0];
+   store = NULL;
+   (void)mstime("2013/01/01", &t); t0 = t;
+
+   for(i=1; i<argc; i++) {
+      if (argv[i][0] == '-') { /* Check for option */
+         if (0 == strcmp(argv[i], "-2")) {
+	    vers = 2;
+         } else if (0 == strcmp(argv[i], "-3")) {
+	    vers = 3;
+         } else if (i+1 < argc && 0 == strcmp(argv[i], "-H")) {
+	    hours = strtod(argv[++i], &p);
+	    if (*p || hours <= 0) err("bad -H value");
+         } else if (i+1 < argc && 0 == strcmp(argv[i], "-M")) {
+	    smb = strtod(argv[++i], &p);
+	    if (*p || smb <= 0) err("bad -M value");
+         } else if (i+1 < argc && 0 == strcmp(argv[i], "-F")) {
+	    fmb = strtod(argv[++i], &p);
+	    if (*p || fmb < 1) err("bad -F value");
+         } else if (i+1 < argc && 0 == strcmp(argv[i], "-r")) {
+	    int r = strtol(argv[++i], &p, 10);
+	    if (*p || r < 1) err("bad -r value");
+	    if (r <= 127) srf = r, srm = 1;
+	    else if (r % 100 == 0 && r/100 <= 127) srf = 100, srm = r/100;
+	    else err("-r value must be <= 127 or a multiple of 100");
+         } else if (i+1 < argc && 0 == strcmp(argv[i], "-c")) {
+	    nc = strtol(argv[++i], &p, 10);
+	    if (*p || (nc != 3 && nc != 6)) err("bad -c value");
+         } else if (i+1 < argc && 0 == strcmp(argv[i], "-t")) {
+	    if (mstime(argv[++i], &t)) err("bad -t time");
+	    t0 = t;
+         } else if (i+1 < argc && 0 == strcmp(argv[i], "-i")) {
+	    iid = strtol(argv[++i], &p, 10);
+	    if (*p || iid < 0 || iid > 65535) err("bad -i value");
+         } else if (i+1 < argc && 0 == strcmp(argv[i], "-x")) {
+	    xfrac = strtod(argv[++i], &p);
+	    if (*p || xfrac < 0 || xfrac > 1) err("bad -x value");
+         } else if (i+1 < argc && 0 == strcmp(argv[i], "-d")) {
+	    dfrac = strtod(argv[++i], &p);
+	    if (*p || dfrac < 0 || dfrac > 1) err("bad -d value");
+         } else if (i+1 < argc && 0 == strcmp(argv[i], "-s")) {
+	    seed = strtoull(argv[++i], &p, 10);
+	    if (*p) err("bad -s value");
+         } else if (0 == strcmp(argv[i], "-h")) {
+	    usage();
+	 } else {
+	    fprintf(stderr, "bad arg (ignored): %s\n", argv[i]);
+	 }
+      } else {
+         store = argv[i];
+      }
+   }
+   if (store == NULL) err("no store file given");
+   if (nc > 3 && vers != 3) err("-c 6 only for v3 stores");
+   p = strstr(store, "001.store");
+   if (p == NULL || strcmp(p, "001.store")) err("store name must end in 001.store");
+   six = p - store;
+
+   mksine();
+   make();                         /* Size sections */
+   layout();
+   wrt = 1; isec = 0;
+   make();                         /* Write them */
+   if (fclose(sfd)) err("error writing store file");
+
+   printf("packets %llu %llu bytes %llu files %d samples %llu\n",
+      (unsigned long long)ndat, (unsigned long long)nsoh,
+      (unsigned long long)ssize, nfile, (unsigned long long)nsmp);
+   return 0;
+}
@@ -0,0 +1,324 @@
+/* Check continuity of the MSEED data in a data pool from record headers.
+
+   G. Helffrich/U. Bristol
+      18 Oct. 2026
+
+Usage:  mseedgap {-h | -v | -d | -b <size> | -j <n> | -t <frac>} ...
+           [<file> ...]
+
+Command line parameters:
+   -h - usage (this text)
+   -v - verbose output
+   -d - also report coverage of each day (percent of day with data)
+   -b <size> - record size to assume if a record lacks a type 1000 blockette
+      (otherwise record size is taken from each record's blockette 1000).
+   -j <n> - read files with <n> parallel workers (default: number of CPUs)
+   -t <frac> - tolerance, in samples, allowed between the end of one record
+      and the start of the next before a gap or overlap is reported
+      (default 0.5)
+   <file> ... - files to check.  If none given, file names are read from the
+      standard input, e.g.
+         ls /data/mseed/BABY*BH? | mseedgap -d
+
+   Only record headers are used: each record covers the time from its first
+   sample to the time one sample past its last (from the sample count and
+   rate).  Records of each stream from all the files are pooled, so the files
+   may be in any order and may be split at any time boundary.  Output lines
+   are
+
+      gap NET.STA.LOC.CHN <from> <to> <seconds>
+      overlap NET.STA.LOC.CHN <from> <to> <seconds>
+      day NET.STA.LOC.CHN yyyy/mm/dd <percent>
+
+   Files may be compressed (tv3mseed -c); they are read as they are
+   decompressed.  This replaces the file name-based day checks of chkdays.sh.
+*/
+
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include "msrec.h"
+#include "msz.h"
+
+#define DAY 86400000000000ll
+#define CHUNK 0x100000
+
+char *prog;
+
+short verb = 0;
+
+int lrdef = 0;
+double tolf = 0.5;
+
+/* Time span covered by a run of contiguous records */
+struct span {
+   char sid[24];
+   int64_t t0, t1;                 /* Start, end (ns) */
+   int64_t tol;                    /* Gap tolerance (ns) */
+};
+
+/* Per-file work */
+struct job {
+   char *fn;
+   struct span *sp;
+   size_t nsp, msp;
+};
+
+struct job *jobs = NULL;
+size_t njob = 0, mjob = 0, jnext = 0;
+pthread_mutex_t jlock = PTHREAD_MUTEX_INITIALIZER;
+
+void usage(){
+   char *msg =
+   " {-h | -v | -d | -b <size> | -j <n> | -t <frac>} ... [<file> ...]\n"
+   " Options:\n"
+   "   -h - usage (this text)\n"
+   "   -v - verbose output\n"
+   "   -d - also report percent coverage for each day\n"
+   "   -b <size> - record size if no blockette 1000 in record\n"
+   "   -j <n> - number of parallel file readers (default: # CPUs)\n"
+   "   -t <frac> - gap/overlap tolerance in samples (default 0.5)\n"
+   "   <file> ... - files to check (names read from std. input if none)\n";
+   fprintf(stderr, "Usage: %s%s", prog, msg);
+   fflush(stderr);
+}
+
+void err(char *msg){
+   fprintf(stderr, "%s: %s\n", prog, msg); fflush(stderr);
+   exit(1);
+}
+
+void *grow(void *p, size_t *max, size_t need, size_t siz){
+   if (need <= *max) return p;
+   *max = need > 2*(*max) ? need : 2*(*max);
+   p = realloc(p, *max * siz);
+   if (p == NULL) err("out of memory");
+   return p;
+}
+
+/* Read headers of one file, reducing its records to spans of contiguous
+   data */
+
+void scan(struct job *j, unsigned char *buf){
+   struct mshdr h;
+   struct msz *z;
+   struct span *s = NULL;
+   char sid[32];
+   size_t len = 0, pos = 0;
+   uint64_t off = 0;
+   int fd, lrecl;
+
+   fd = strcmp(j->fn, "-") ? open(j->fn, O_RDONLY) : 0;
+   if (fd < 0 || NULL == (z = mszfd(fd))) {
+      fprintf(stderr, "%s: can't open %s, skipped\n", prog, j->fn);
+      if (fd > 0) close(fd);
+      return;
+   }
+   for(;;) {
+      int64_t t1;
+      if (len-pos < MSMAXREC) {
+         memmove(buf, buf+pos, len-pos); len -= pos; pos = 0;
+	 while (len < CHUNK) {
+	    ssize_t got = mszread(z, buf+len, CHUNK+MSMAXREC-len);
+	    if (got <= 0) break;
+	    len += got;
+	 }
+      }
+      if (len-pos < 128) break;
+      if (msdec(buf+pos, &h)) {
+         fprintf(stderr, "%s: %s at offset %llx: not a data record, "
+	    "rest of file skipped\n", prog, j->fn, (unsigned long long)off);
+	 break;
+      }
+      lrecl = h.lrecl ? h.lrecl : lrdef;
+      if (lrecl <= 0) {
+         fprintf(stderr, "%s: %s at offset %llx: no blockette 1000, "
+	    "use -b; rest of file skipped\n", prog, j->fn,
+	    (unsigned long long)off);
+	 break;
+      }
+      if (lrecl > len-pos) {
+         fprintf(stderr, "%s: %s at offset %llx: short record, "
+	    "rest of file skipped\n", prog, j->fn, (unsigned long long)off);
+	 break;
+      }
+      off += lrecl; pos += lrecl;
+      if (h.rate <= 0 || h.nsamp == 0) continue;   /* No time span */
+      mssid(&h, sid);
+      t1 = msend(&h);
+      if (s && 0 == strncmp(sid, s->sid, sizeof(s->sid))
+       && h.tns >= s->t1 - s->tol && h.tns <= s->t1 + s->tol) {
+         s->t1 = t1;
+	 continue;
+      }
+      j->sp = grow(j->sp, &j->msp, j->nsp+1, sizeof(struct span));
+      s = j->sp + j->nsp++;
+      memset(s->sid, 0, sizeof(s->sid));
+      strncpy(s->sid, sid, sizeof(s->sid)-1);
+      s->t0 = h.tns; s->t1 = t1;
+      s->tol = (int64_t)(1e9*tolf/h.rate);
+   }
+   mszclose(z);
+}
+
+void *worker(void *arg){
+   unsigned char *buf = malloc(CHUNK+MSMAXREC);
+   size_t i;
+
+   if (buf == NULL) err("out of memory");
+   for(;;) {
+      pthread_mutex_lock(&jlock);
+      i = jnext++;
+      pthread_mutex_unlock(&jlock);
+      if (i >= njob) break;
+      scan(jobs+i, buf);
+   }
+   free(buf);
+   return NULL;
+}
+
+int cmspan(const void *a, const void *b){
+   const struct span *x = a, *y = b;
+   int c = strncmp(x->sid, y->sid, sizeof(x->sid));
+   if (c) return c;
+   return (x->t0 > y->t0) - (x->t0 < y->t0);
+}
+
+void report(char *what, char *sid, int64_t t0, int64_t t1){
+   char s0[32], s1[32];
+   msfmt(t0, s0); msfmt(t1, s1);
+   printf("%s %s %s %s %.4f\n", what, sid, s0, s1, 1e-9*(t1-t0));
+}
+
+/* Accumulate covered time of [t0, t1) into daily totals starting at day0 */
+
+void cover(int64_t *cov, int64_t day0, int64_t t0, int64_t t1){
+   while (t0 < t1) {
+      int64_t d = t0/DAY, e = (d+1)*DAY;
+      if (e > t1) e = t1;
+      cov[d-day0] += e-t0;
+      t0 = e;
+   }
+}
+
+void days(char *sid, int64_t *cov, int64_t day0, int64_t ndays){
+   int64_t d;
+   char s[32];
+   for(d=0; d<ndays; d++) {
+      msfmt((day0+d)*DAY, s); s[10] = 0;
+      printf("day %s %s %.2f\n", sid, s, 100.0*cov[d]/DAY);
+   }
+}
+
+int main(int argc, char *argv[]){
+   struct span *sp = NULL;
+   pthread_t *tid;
+   size_t j, nsp = 0, msp = 0, a, b;
+   int i, nthr = 0, oday = 0;
+   long ncpu;
+   char line[4096];
+
+   prog = argv[0];
+
+   for(i=1; i<argc; i++) {
+      if (argv[i][0] == '-' && argv[i][1]) { /* Check for option */
+         if (i+1 < argc && 0 == strcmp(argv[i], "-b")) {
+	    char *p;
+	    lrdef = strtol(argv[++i], &p, 10);
+	    if (*p || lrdef < 128 || lrdef > MSMAXREC) err("bad -b value");
+         } else if (i+1 < argc && 0 == strcmp(argv[i], "-j")) {
+	    char *p;
+	    nthr = strtol(argv[++i], &p, 10);
+	    if (*p || nthr < 1) err("bad -j value");
+         } else if (i+1 < argc && 0 == strcmp(argv[i], "-t")) {
+	    char *p;
+	    tolf = strtod(argv[++i], &p);
+	    if (*p || tolf <= 0) err("bad -t value");
+         } else if (0 == strcmp(argv[i], "-d")) {
+	    oday = 1;
+         } else if (0 == strcmp(argv[i], "-v")) {
+	    verb = 1;
+         } else if (0 == strcmp(argv[i], "-h")) {
+	    usage();
+	 } else {
+	    fprintf(stderr, "bad arg (ignored): %s\n", argv[i]);
+	 }
+      } else {
+         jobs = grow(jobs, &mjob, njob+1, sizeof(struct job));
+	 memset(jobs+njob, 0, sizeof(struct job));
+	 jobs[njob++].fn = argv[i];
+      }
+   }
+   if (njob == 0) {
+      while (fgets(line, sizeof(line), stdin)) {
+         line[strcspn(line, "\n")] = 0;
+	 if (line[0] == 0) continue;
+         jobs = grow(jobs, &mjob, njob+1, sizeof(struct job));
+	 memset(jobs+njob, 0, sizeof(struct job));
+	 jobs[njob++].fn = strdup(line);
+      }
+   }
+   if (njob == 0) err("no files to check");
+
+   /* Read files in parallel */
+   ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+   if (nthr == 0) nthr = ncpu > 0 ? ncpu : 1;
+   if (nthr > njob) nthr = njob;
+   tid = malloc(nthr*sizeof(pthread_t));
+   if (tid == NULL) err("out of memory");
+   for(i=0;i<nthr;i++)
+      if (pthread_create(tid+i, NULL, worker, NULL)) err("can't start thread");
+   for(i=0;i<nthr;i++) pthread_join(tid[i], NULL);
+
+   /* Pool spans of each stream, sort and check */
+   for(j=0;j<njob;j++){
+      sp = grow(sp, &msp, nsp+jobs[j].nsp, sizeof(struct span));
+      if (jobs[j].nsp)
+         memcpy(sp+nsp, jobs[j].sp, jobs[j].nsp*sizeof(struct span));
+      nsp += jobs[j].nsp;
+      free(jobs[j].sp);
+   }
+   if (verb) fprintf(stderr, "%s: %zu files, %zu spans, %d readers\n",
+      prog, njob, nsp, nthr);
+   qsort(sp, nsp, sizeof(struct span), cmspan);
+
+   for(a=0; a<nsp; a=b){
+      int64_t end = sp[a].t1, day0, ndays, *cov = NULL;
+      for(b=a+1; b<nsp && 0 == strncmp(sp[a].sid, sp[b].sid, 24); b++);
+      if (oday) {
+         int64_t last = sp[a].t1;
+	 for(j=a; j<b; j++) if (sp[j].t1 > last) last = sp[j].t1;
+	 day0 = sp[a].t0/DAY; ndays = (last-1)/DAY - day0 + 1;
+	 cov = calloc(ndays, sizeof(int64_t));
+	 if (cov == NULL) err("out of memory");
+      }
+      for(j=a+1; j<b; j++){
+         struct span *s = sp+j;
+	 if (s->t0 > end + s->tol) {
+	    report("gap", s->sid, end, s->t0);
+	 } else if (s->t0 < end - s->tol) {
+	    report("overlap", s->sid, s->t0, s->t1 < end ? s->t1 : end);
+	 }
+	 if (s->t1 > end) end = s->t1;
+      }
+      if (oday) {
+         /* Coverage is the union of the spans */
+	 int64_t u0 = sp[a].t0, u1 = sp[a].t1;
+	 for(j=a+1; j<b; j++){
+	    if (sp[j].t0 > u1) {
+	       cover(cov, day0, u0, u1);
+	       u0 = sp[j].t0;
+	    }
+	    if (sp[j].t1 > u1) u1 = sp[j].t1;
+	 }
+	 cover(cov, day0, u0, u1);
+	 days(sp[a].sid, cov, day0, ndays);
+	 free(cov);
+      }
+   }
+   return 0;
+}
@@ -0,0 +1,445 @@
+/* Build and query a catalog of the MSEED files in a data pool.
+
+   G. Helffrich/U. Bristol
+      18 Oct. 2026
+
+Usage:  mseedidx -o <index> [-b <size>] [-v] [<file> ...]
+        mseedidx -q <index> -s <time> -e <time> [-c <chn>[,<chn>...]]
+           [-S <sta>] [-N <net>] [-L <loc>] [-x]
+
+Command line parameters:
+   -h - usage (this text)
+   -v - verbose output
+   -o <index> - Scan the headers of the named MSEED files (or, if none are
+      given, file names read from the standard input) and write a catalog
+      of them to <index>.
+   -b <size> - record size to assume if a record lacks a type 1000 blockette
+      (otherwise record size is taken from each record's blockette 1000).
+   -q <index> - Query catalog <index> for data in a time window.  Output is
+      a list of file names, byte offsets and lengths, one line for each
+      contiguous run of records that cover the window.
+   -s <time>, -e <time> - start and end of query window, given as
+      yyyy/mm/dd[Thh:mm[:ss]]
+   -c <chn>,... - only report these channels (e.g. BHZ,BHN,BHE)
+   -S <sta>, -N <net>, -L <loc> - only report this station, network or
+      location ID
+   -x - copy the records in the window to the standard output rather than
+      listing their location.
+
+   The catalog holds, for each run of records of one stream in a file, its
+   stream ID, start and end time, record count, file name and the byte offset
+   of the record containing each hour boundary.  A query uses the hour marks
+   and then a few record headers near the window's ends to find its exact
+   extent, so cutting event windows out of a multi-year pool touches only
+   the records needed.  Records in a file that are not in time order
+   are catalogued as a whole; the query then returns the whole run.
+*/
+
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include "msrec.h"
+
+#define HOUR 3600000000000ll
+#define CHUNK 0x100000
+
+char *prog;
+
+short verb = 0;
+
+/* Catalog file layout: header, entries, hour marks, file name strings */
+struct ixhdr {
+   char magic[4];                  /* "MSIX" */
+   uint32_t vers, nent, nhr, nstr;
+};
+
+struct ixent {
+   char sid[24];                   /* NET.STA.LOC.CHN */
+   int64_t t0, t1;                 /* First sample, end of last record */
+   uint64_t off0, off1;            /* Byte extent in file */
+   uint32_t nrec, lrecl;           /* Record count, length (0 if varies) */
+   uint32_t path, hr0, nhr, sorted;
+};
+
+struct ixhr {
+   int64_t t;                      /* Hour boundary */
+   uint64_t off;                   /* Record containing or preceding it */
+};
+
+struct ixent *ent = NULL;
+struct ixhr *hrs = NULL;
+char *str = NULL;
+size_t nent = 0, nhr = 0, nstr = 0, ment = 0, mhr = 0, mstr = 0;
+
+void usage(){
+   char *msg =
+   " {-o <index> [-b <size>] [<file> ...] |\n"
+   "        -q <index> -s <time> -e <time> [-c <chn>,...] [-S <sta>]\n"
+   "           [-N <net>] [-L <loc>] [-x]}\n"
+   " Options:\n"
+   "   -h - usage (this text)\n"
+   "   -v - verbose output\n"
+   "   -o <index> - catalog named files (or names on std. input) into"
+   " <index>\n"
+   "   -b <size> - record size if no blockette 1000 in record\n"
+   "   -q <index> - query catalog <index> for a time window\n"
+   "   -s <time>, -e <time> - window start, end as yyyy/mm/dd[Thh:mm[:ss]]\n"
+   "   -c <chn>,... - only these channels\n"
+   "   -S <sta>, -N <net>, -L <loc> - only this station, network, loc ID\n"
+   "   -x - copy window's records to std. output rather than list them\n";
+   fprintf(stderr, "Usage: %s%s", prog, msg);
+   fflush(stderr);
+}
+
+void err(char *msg){
+   fprintf(stderr, "%s: %s\n", prog, msg); fflush(stderr);
+   exit(1);
+}
+
+void *grow(void *p, size_t *max, size_t need, size_t siz){
+   if (need <= *max) return p;
+   *max = need > 2*(*max) ? need : 2*(*max);
+   p = realloc(p, *max * siz);
+   if (p == NULL) err("out of memory");
+   return p;
+}
+
+/* Add an hour mark to the current entry */
+
+void addhr(int64_t t, uint64_t off){
+   hrs = grow(hrs, &mhr, nhr+1, sizeof(struct ixhr));
+   hrs[nhr].t = t; hrs[nhr].off = off;
+   nhr += 1; ent[nent-1].nhr += 1;
+}
+
+/* Catalog one file */
+
+void scan(char *fn, int lrdef){
+   static unsigned char *buf = NULL;
+   struct mshdr h;
+   struct ixent *e = NULL;
+   char sid[32];
+   size_t len = 0, pos = 0, n, path;
+   uint64_t off = 0, prev = 0;
+   int64_t hnext = 0, tprev = 0;
+   int fd, lrecl;
+
+   if (buf == NULL && NULL == (buf = malloc(CHUNK+MSMAXREC)))
+      err("out of memory");
+   fd = open(fn, O_RDONLY);
+   if (fd < 0) {
+      fprintf(stderr, "%s: can't open %s, skipped\n", prog, fn);
+      return;
+   }
+   path = nstr;
+   n = strlen(fn)+1;
+   str = grow(str, &mstr, nstr+n, 1);
+   memcpy(str+nstr, fn, n); nstr += n;
+
+   for(;;) {
+      /* Keep at least a whole maximum-size record in the buffer */
+      if (len-pos < MSMAXREC) {
+         memmove(buf, buf+pos, len-pos); len -= pos; pos = 0;
+	 while (len < CHUNK) {
+	    ssize_t got = read(fd, buf+len, CHUNK+MSMAXREC-len);
+	    if (got <= 0) break;
+	    len += got;
+	 }
+      }
+      if (len-pos < 128) break;
+      if (msdec(buf+pos, &h)) {
+         fprintf(stderr, "%s: %s at offset %llx: not a data record, "
+	    "rest of file skipped\n", prog, fn, (unsigned long long)off);
+	 break;
+      }
+      lrecl = h.lrecl ? h.lrecl : lrdef;
+      if (lrecl <= 0) {
+         fprintf(stderr, "%s: %s at offset %llx: no blockette 1000, "
+	    "use -b; rest of file skipped\n", prog, fn,
+	    (unsigned long long)off);
+	 break;
+      }
+      if (len-pos < lrecl) {
+         fprintf(stderr, "%s: %s: partial record at end ignored\n", prog, fn);
+	 break;
+      }
+      mssid(&h, sid);
+      if (e == NULL || strncmp(sid, e->sid, sizeof(e->sid))) {
+         /* New run of records for a stream */
+	 ent = grow(ent, &ment, nent+1, sizeof(struct ixent));
+	 e = ent + nent++;
+	 memset(e, 0, sizeof(*e));
+	 strncpy(e->sid, sid, sizeof(e->sid)-1);
+	 e->t0 = h.tns; e->t1 = msend(&h);
+	 e->off0 = off; e->lrecl = lrecl;
+	 e->path = path; e->hr0 = nhr; e->sorted = 1;
+	 hnext = (h.tns/HOUR + 1)*HOUR;
+      } else {
+         if (h.tns < tprev) e->sorted = 0;
+         if (e->sorted) while (h.tns >= hnext) {
+	    addhr(hnext, h.tns == hnext ? off : prev);
+	    hnext += HOUR;
+	 }
+	 if (h.tns < e->t0) e->t0 = h.tns;
+	 if (msend(&h) > e->t1) e->t1 = msend(&h);
+	 if (e->lrecl != lrecl) e->lrecl = 0;
+      }
+      e->nrec += 1;
+      e->off1 = off + lrecl;
+      prev = off; tprev = h.tns;
+      off += lrecl; pos += lrecl;
+   }
+   close(fd);
+}
+
+int cment(const void *a, const void *b){
+   const struct ixent *x = a, *y = b;
+   int c = strncmp(x->sid, y->sid, sizeof(x->sid));
+   if (c) return c;
+   return (x->t0 > y->t0) - (x->t0 < y->t0);
+}
+
+void build(char *index, char **files, int nfiles, int lrdef){
+   struct ixhdr ih;
+   FILE *fd;
+   char line[4096];
+   int i;
+
+   if (nfiles > 0) {
+      for(i=0;i<nfiles;i++) scan(files[i], lrdef);
+   } else {
+      while (fgets(line, sizeof(line), stdin)) {
+         line[strcspn(line, "\n")] = 0;
+	 if (line[0]) scan(line, lrdef);
+      }
+   }
+   qsort(ent, nent, sizeof(struct ixent), cment);
+
+   fd = fopen(index, "w");
+   if (fd == NULL) err("can't write index file");
+   memcpy(ih.magic, "MSIX", 4); ih.vers = 1;
+   ih.nent = nent; ih.nhr = nhr; ih.nstr = nstr;
+   if (1 != fwrite(&ih, sizeof(ih), 1, fd)
+    || nent != fwrite(ent, sizeof(struct ixent), nent, fd)
+    || nhr != fwrite(hrs, sizeof(struct ixhr), nhr, fd)
+    || nstr != fwrite(str, 1, nstr, fd)
+    || fclose(fd)) err("error writing index file");
+   if (verb) fprintf(stderr, "%s: %zu entries, %zu hour marks\n",
+      prog, nent, nhr);
+}
+
+void load(char *index){
+   struct ixhdr ih;
+   FILE *fd = fopen(index, "r");
+
+   if (fd == NULL) err("can't open index file");
+   if (1 != fread(&ih, sizeof(ih), 1, fd)) err("bad index file");
+   if (strncmp(ih.magic, "MSIX", 4) || ih.vers != 1)
+      err("not an index file (or made on a different type of machine)");
+   nent = ih.nent; nhr = ih.nhr; nstr = ih.nstr;
+   ent = malloc(nent*sizeof(struct ixent) + 1);
+   hrs = malloc(nhr*sizeof(struct ixhr) + 1);
+   str = malloc(nstr + 1);
+   if (ent == NULL || hrs == NULL || str == NULL) err("out of memory");
+   if (nent != fread(ent, sizeof(struct ixent), nent, fd)
+    || nhr != fread(hrs, sizeof(struct ixhr), nhr, fd)
+    || nstr != fread(str, 1, nstr, fd)) err("truncated index file");
+   fclose(fd);
+}
+
+/* Does stream ID match selection criteria? */
+
+int match(char *sid, char *chn, char *sta, char *net, char *loc){
+   char f[4][8], *p = sid;
+   int i, l;
+
+   for(i=0;i<4;i++){
+      l = strcspn(p, ".");
+      if (l >= sizeof(f[i])) return 0;
+      memcpy(f[i], p, l); f[i][l] = 0;
+      p += l; if (*p) p++;
+   }
+   if (net && strcmp(net, f[0])) return 0;
+   if (sta && strcmp(sta, f[1])) return 0;
+   if (loc && strcmp(loc, f[2])) return 0;
+   if (chn) {
+      l = strlen(f[3]);
+      for(p=chn; *p; p += strcspn(p, ","), p += *p == ',') {
+         if (strcspn(p, ",") == l && 0 == strncmp(p, f[3], l)) return 1;
+      }
+      return 0;
+   }
+   return 1;
+}
+
+/* Read and decode header of record at off */
+
+int rhdr(int fd, uint64_t off, struct mshdr *h){
+   unsigned char rec[128];
+   if (128 != pread(fd, rec, 128, off)) return -1;
+   return msdec(rec, h);
+}
+
+/* Find exact extent of records in [lo, hi) that overlap [ts, te).  With a
+   fixed record length, a binary search on record headers does it; otherwise
+   the records are read through. */
+
+void refine(int fd, struct ixent *e, uint64_t *lo, uint64_t *hi,
+   int64_t ts, int64_t te
+){
+   struct mshdr h;
+   uint64_t first = *hi, last = *lo;
+
+   if (e->lrecl) {
+      uint64_t l = e->lrecl, a, b, m;
+      /* First record ending after ts */
+      for(a=(*lo-e->off0)/l, b=(*hi-e->off0)/l; a<b; ) {
+         m = (a+b)/2;
+	 if (rhdr(fd, e->off0+m*l, &h)) return;
+	 if (msend(&h) > ts) b = m; else a = m+1;
+      }
+      first = e->off0+a*l;
+      /* First record starting at or after te */
+      for(b=(*hi-e->off0)/l; a<b; ) {
+         m = (a+b)/2;
+	 if (rhdr(fd, e->off0+m*l, &h)) return;
+	 if (h.tns >= te) b = m; else a = m+1;
+      }
+      last = e->off0+a*l;
+   } else {
+      size_t len = *hi - *lo, pos;
+      unsigned char *buf = malloc(len);
+      if (buf == NULL) err("out of memory");
+      if (len != pread(fd, buf, len, *lo)) {
+	 free(buf); return;
+      }
+      for(pos=0; pos+128 <= len && 0 == msdec(buf+pos, &h); pos += h.lrecl) {
+	 if (h.lrecl <= 0) break;
+	 if (h.tns < te && msend(&h) > ts) {
+	    if (*lo+pos < first) first = *lo+pos;
+	    last = *lo+pos+h.lrecl;
+	 }
+      }
+      free(buf);
+   }
+   if (first < last) *lo = first, *hi = last;
+   else *lo = *hi;
+}
+
+void query(int64_t ts, int64_t te,
+   char *chn, char *sta, char *net, char *loc, int oext
+){
+   size_t i;
+   int j;
+   static char buf[CHUNK];
+
+   for(i=0;i<nent;i++){
+      struct ixent *e = ent+i;
+      struct ixhr *hr = hrs + e->hr0;
+      uint64_t lo = e->off0, hi = e->off1;
+      char *fn = str + e->path;
+      int fd;
+
+      if (e->t0 >= te || e->t1 <= ts) continue;
+      if (!match(e->sid, chn, sta, net, loc)) continue;
+      fd = open(fn, O_RDONLY);
+      if (fd < 0) {
+         fprintf(stderr, "%s: can't open %s, skipped\n", prog, fn);
+	 continue;
+      }
+      if (e->sorted) {
+         /* Hour marks bracket the window; an hour's records refine it */
+	 for(j=0; j<e->nhr && hr[j].t <= ts; j++) lo = hr[j].off;
+	 for(j=e->nhr-1; j>=0 && hr[j].t >= te; j--) hi = hr[j].off;
+	 if (hi < e->off1) {
+	    /* Include record that straddles the boundary found */
+	    struct mshdr h;
+	    int lrecl = e->lrecl;
+	    if (lrecl == 0 && 0 == rhdr(fd, hi, &h)) lrecl = h.lrecl;
+	    hi += lrecl;
+	 }
+	 refine(fd, e, &lo, &hi, ts, te);
+      }
+      if (lo < hi) {
+         if (!oext)
+	    printf("%s %llu %llu\n", fn,
+	       (unsigned long long)lo, (unsigned long long)(hi-lo));
+	 else while (lo < hi) {
+	    size_t n = hi-lo > sizeof(buf) ? sizeof(buf) : hi-lo;
+	    ssize_t got = pread(fd, buf, n, lo);
+	    if (got <= 0) {
+	       fprintf(stderr, "%s: read error on %s\n", prog, fn);
+	       break;
+	    }
+	    if (got != fwrite(buf, 1, got, stdout))
+	       err("error writing standard output");
+	    lo += got;
+	 }
+      }
+      close(fd);
+   }
+}
+
+int main(int argc, char *argv[]){
+   char *obld = NULL, *oqry = NULL;
+   char *chn = NULL, *sta = NULL, *net = NULL, *loc = NULL;
+   char **files;
+   int64_t ts = 0, te = 0;
+   int i, nfiles = 0, lrdef = 0, oext = 0, ots = 0, ote = 0;
+
+   prog = argv[0];
+   files = malloc(argc*sizeof(char*));
+   if (files == NULL) err("out of memory");
+
+   for(i=1; i<argc; i++) {
+      if (argv[i][0] == '-') { /* Check for option */
+         if (i+1 < argc && 0 == strcmp(argv[i], "-o")) {
+	    obld = argv[++i];
+         } else if (i+1 < argc && 0 == strcmp(argv[i], "-q")) {
+	    oqry = argv[++i];
+         } else if (i+1 < argc && 0 == strcmp(argv[i], "-b")) {
+	    char *p;
+	    lrdef = strtol(argv[++i], &p, 10);
+	    if (*p || lrdef < 128 || lrdef > MSMAXREC) err("bad -b value");
+         } else if (i+1 < argc && 0 == strcmp(argv[i], "-s")) {
+	    if (mstime(argv[++i], &ts)) err("bad -s time");
+	    ots = 1;
+         } else if (i+1 < argc && 0 == strcmp(argv[i], "-e")) {
+	    if (mstime(argv[++i], &te)) err("bad -e time");
+	    ote = 1;
+         } else if (i+1 < argc && 0 == strcmp(argv[i], "-c")) {
+	    chn = argv[++i];
+         } else if (i+1 < argc && 0 == strcmp(argv[i], "-S")) {
+	    sta = argv[++i];
+         } else if (i+1 < argc && 0 == strcmp(argv[i], "-N")) {
+	    net = argv[++i];
+         } else if (i+1 < argc && 0 == strcmp(argv[i], "-L")) {
+	    loc = argv[++i];
+         } else if (0 == strcmp(argv[i], "-x")) {
+	    oext = 1;
+         } else if (0 == strcmp(argv[i], "-v")) {
+	    verb = 1;
+         } else if (0 == strcmp(argv[i], "-h")) {
+	    usage();
+	 } else {
+	    fprintf(stderr, "bad arg (ignored): %s\n", argv[i]);
+	 }
+      } else {
+         files[nfiles++] = argv[i];
+      }
+   }
+
+   if ((obld == NULL) == (oqry == NULL)) err("give one of -o or -q");
+   if (obld) {
+      build(obld, files, nfiles, lrdef);
+   } else {
+      if (!ots || !ote) err("query needs -s and -e times");
+      if (te <= ts) err("-e time not after -s time");
+      load(oqry);
+      query(ts, te, chn, sta, net, loc, oext);
+   }
+   return 0;
+}
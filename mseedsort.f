@@ -4,25 +4,33 @@ C     and start time of the first sample in each blockette.
 C
 C     As command line argument, give MSEED file name.
 C     Options:
-C       -b # - block size in bytes [default 512]
+C       -b # - block size in bytes for records without a blockette 1000
+C          [default 512]
 C       -o <file> - untangle blocks and write to <file>;
 C          std input is a list of block numbers to write
+C     The MSEED file may be compressed (tv3mseed -c); records are read
+C     through the routines in msz.c, which handle either kind.  Each
+C     record's length is taken from its blockette 1000, so files of any
+C     record size (up to 64 KB) are read without giving -b.  Sequence
+C     numbers may wrap from 999999 to 000000.
 C
 C     By George Helffrich, U. Bristol, July 14, 2011
 C        last update Jan. 31, 2019
+C        updated 18 Oct. 2026
       program rnmseed
-      parameter (mxbuf=8192, iucd=99, iuof=98)
+      parameter (mxbuf=65536, iuof=98)
       character posstr*16
       character cdname*256, fn*256, sname*32, posn*16
       character inbuf*(mxbuf), locid*2, netwk*2
-      integer lrecl
+      integer lrecl, lrdef
       logical olst, owrt, oquiet
 
       olst = .true.
       owrt = .false.
       oquiet = .false.
-      lrecl = 512
+      lrdef = 512
       nprec = 1
+      nlast = 0
       n = 0
       iskip = 0
       do 5 i=1,iargc()
@@ -32,9 +40,9 @@ C        last update Jan. 31, 2019
 	    if (posn .eq. '-b') then
 	       call getarg(i+1,posn)
 	       ios = -1
-	       if (posn .ne. ' ') read(posn,*,iostat=ios) lrecl
+	       if (posn .ne. ' ') read(posn,*,iostat=ios) lrdef
 	       if (ios .ne. 0) stop '**Bad -b value'
-	       if (lrecl .gt. mxbuf) stop '**-b value too large'
+	       if (lrdef .gt. mxbuf) stop '**-b value too large'
 	       iskip = i+1
 	    else if (posn .eq. '-o') then
 	       call getarg(i+1,fn)
@@ -47,7 +55,8 @@ C        last update Jan. 31, 2019
 	       call getarg(0,sname)
 	       ix = index(sname,' ')-1
 	       write(0,*) ' usage:  ',sname(1:ix),' [options] file'
-	       write(0,*) ' -b <size> - block size (512 default)'
+	       write(0,*) ' -b <size> - block size if no blockette 1000',
+     &            ' (512 default)'
 	       write(0,*) ' -o <file> - rewrite file in sort order'
 	       write(0,*) '      stdin gives record # rewrite order'
 	       write(0,*) ' -q - don''t complain about record # order'
@@ -63,32 +72,30 @@ C        last update Jan. 31, 2019
 5     continue
 
       if (n .eq. 0) stop '**No input file name given.'
-      open(iucd,file=cdname,
-     &      access='direct',
-     &      form='unformatted',
-     &      recl=lrecl,
-     &      iostat=ios)
+      call mszopn(cdname,iz,ios)
       if (ios .ne. 0) stop '**Bad file name, can''t open.'
 
       if (owrt) then
          open(iuof,file=fn,
-     &      access='direct',
+     &      access='stream',
      &      form='unformatted',
-     &      recl=lrecl,
      &      iostat=ios)
          if (ios .ne. 0) stop '**Bad output file name, can''t write.'
       endif
 
 1000  continue
          if (olst) then
-	    read(iucd, rec=nprec, err=9100) inbuf(1:lrecl)
+	    call mszrd(iz,nprec,lrdef,inbuf,lrecl,ios)
+	    if (ios .ne. 0) go to 9100
 	    read(inbuf(1:6),*,iostat=ios) nrec
-	    if (.not.oquiet .and.
-     &         (ios .ne. 0 .or. nrec .ne. mod(nprec,1 000 000))
+	    if (.not.oquiet .and. (ios .ne. 0 .or.
+     &         (nprec .gt. 1 .and. nrec .ne. mod(nlast+1,1 000 000)))
      &      ) then
 	       write(0,*) '**Read error: blocks out of sequence.'
-	       write(0,*) '**Expecting ',nprec,' but got ',inbuf(1:6),'.'
+	       write(0,*) '**Expecting ',mod(nlast+1,1 000 000),
+     &            ' but got ',inbuf(1:6),'.'
 	    endif
+	    nlast = nrec
 	    if (0.eq.index('DRMQ',inbuf(7:7))) then
 	       write(0,*) '**Read error: block ',nprec,
      &            ' is not data block, but is ',inbuf(7:7),'.'
@@ -104,23 +111,24 @@ C           Decode location
 	    if (locid .eq. ' ') locid = '--'
             netwk = inbuf(19:20)
 	    if (netwk .eq. ' ') netwk = '--'
-	    write(*,'(a,1x,a,1x,a,1x,a,1x,i6,1x,a)')
+	    write(*,'(a,1x,a,1x,a,1x,a,1x,i8,1x,a)')
      &         inbuf(9:13),locid,inbuf(16:18),netwk,nprec,sname
 	 else
 	    read(*,*,iostat=ios) nrec
 	    if (ios .ne. 0) then
 	       close(iuof)
-	       close(iucd)
+	       call mszcls(iz)
 	       stop
 	    endif
-	    read(iucd, rec=nrec, err=9300) inbuf(1:lrecl)
+	    call mszrd(iz,nrec,lrdef,inbuf,lrecl,ios)
+	    if (ios .ne. 0) go to 9300
 	    if (0.eq.index('DRMQ',inbuf(7:7))) then
 	       write(0,*) '**Read error: block ',nrec,
      &            ' is not data block, but is ',inbuf(7:7),'.'
 	       go to 9100
 	    endif
 	    write(inbuf(1:6),'(i6.6)') mod(nprec,1 000 000)
-	    write(iuof, rec=nprec, err=9200) inbuf(1:lrecl)
+	    write(iuof, err=9200) inbuf(1:lrecl)
 	 endif
 	 nprec = nprec + 1
       go to 1000
@@ -130,7 +138,7 @@ C           Decode location
 
 9100  continue
       if (nprec.le.1) write(0,*) '**Read error on input file.'
-      close(iucd)
+      call mszcls(iz)
       stop
 
 9200  continue
@@ -3,24 +3,29 @@ C     and write out the information for the station, locid, channel and start
 C     time of the first sample in the file.
 C
 C     As command line argument, give MSEED file name.  Output is start time.
-C     Options:  -b - block size in bytes [default 512]
+C     Options:  -b - block size in bytes for records without a blockette
+C           1000 [default 512]; others have the size it gives, up to 64 KB
 C        -# <num> - read record num [default 1]
 C        -r - if record num does not match sequence #, read anyway
 C        -q - don't check or complain aobout record mismatch (implies -r)
 C
+C     The file may be compressed (tv3mseed -c); records are read through
+C     the routines in msz.c, which handle either kind.
+C
 C     By George Helffrich, U. Bristol, Nov. 10, 2007
 C        updated 31 Jan. 2019.
+C        updated 18 Oct. 2026
       program rnmseed
-      parameter (mxbuf=8192, iucd=99)
+      parameter (mxbuf=65536)
       character posstr*16
       character cdname*256, fn*256, sname*32, posn*16
       character inbuf*(mxbuf), locid*2, netwk*2
-      integer lrecl
+      integer lrecl, lrdef
       logical orec, oquiet
 
       orec = .false.
       oquiet = .false.
-      lrecl = 512
+      lrdef = 512
       nprec = 1
       n = 0
       iskip = 0
@@ -31,9 +36,9 @@ C        updated 31 Jan. 2019.
 	    if (posn .eq. '-b') then
 	       call getarg(i+1,posn)
 	       ios = -1
-	       if (posn .ne. ' ') read(posn,*,iostat=ios) lrecl
+	       if (posn .ne. ' ') read(posn,*,iostat=ios) lrdef
 	       if (ios .ne. 0) stop '**Bad -b value'
-	       if (lrecl .gt. mxbuf) stop '**-b value too large'
+	       if (lrdef .gt. mxbuf) stop '**-b value too large'
 	       iskip = i+1
 	    else if (posn .eq. '-#') then
 	       call getarg(i+1,posn)
@@ -61,17 +66,14 @@ C        updated 31 Jan. 2019.
 	    if (ios.ne.0) stop
 	 endif
 
-         open(iucd,file=cdname,
-     &      access='direct',
-     &      form='unformatted',
-     &      recl=lrecl,
-     &      iostat=ios)
+         call mszopn(cdname,iz,ios)
          if (ios .ne. 0) stop '**Bad file name, can''t open.'
 
-	 read(iucd, rec=nprec, err=9100) inbuf(1:lrecl)
+	 call mszrd(iz,nprec,lrdef,inbuf,lrecl,ios)
+	 if (ios .ne. 0) go to 9100
 	 read(inbuf(1:6),*,iostat=ios) nrec
 	 if (ios .ne. 0 .or.
-     &      (.not.oquiet .and. nrec .ne. nprec)
+     &      (.not.oquiet .and. nrec .ne. mod(nprec,1 000 000))
      &   ) then
 	    write(0,*) '**Read error: blocks out of sequence.'
 	    write(0,*) '**Expecting ',nprec,' but got ',inbuf(1:6),'.'
@@ -95,7 +97,7 @@ C        Decode location
 	 write(*,'(a,1x,a,1x,a,1x,a,1x,a)')
      &      inbuf(9:13),locid,inbuf(16:18),netwk,sname
 9000     continue
-         close(iucd)
+         call mszcls(iz)
          if (n .ne. 0) stop
       go to 1000
 9100  continue
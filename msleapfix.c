@@ -0,0 +1,494 @@
+/* Fix leap second time tears in the MSEED records of a whole data pool.
+
+   G. Helffrich/U. Bristol
+      18 Oct. 2026
+
+Usage:  msleapfix {-h | -v | -n | -b <size> | -j <n> | -l {+1|-1} |
+           -s <time> | -e <time> | -w <file> | -o <dir>} ... [<file|dir> ...]
+
+Command line parameters:
+   -h - usage (this text)
+   -v - verbose output:  report every file, not just those changed
+   -n - only report what would be changed; files are left alone
+   -b <size> - record size to assume if a record lacks a type 1000 blockette
+      (otherwise record size is taken from each record's blockette 1000).
+   -j <n> - fix files with <n> parallel workers (default: number of CPUs)
+   -l +1 or -1 - sense of the leap second; default +1.  Applies to the -s
+      and -e options that follow it.
+   -e <time> - end of a time tear after a leap second (Taurus v3.x, as
+      tv3msleapfix):  records from the leap second up to this time are put
+      back one second.  The leap second is the one at the end of the
+      preceding 30 June or 31 Dec.
+   -s <time> - start of a time tear before a leap second (Taurus v2.x, as
+      tv2msleapfix):  records from this time up to the leap second are put
+      back one second.  The leap second is the one at the end of the
+      following 30 June or 31 Dec.
+   -w <file> - time tears of each station, one per line:
+         <station> {s|e} <time> [+1|-1]
+      with the station code (* for any), whether the time is the tear's
+      start or end (as -s and -e) and the sense of the leap second.  Lines
+      starting with # are ignored.  -s and -e apply to every station.
+   -o <dir> - rather than changing files in place, write the fixed files
+      into a new tree under <dir>.  Files within a directory given on the
+      command line keep their path below it; other files keep their name.
+      Files with nothing to fix are hard linked, if possible, rather than
+      copied.
+   <file|dir> ... - files to fix, or directories holding them (searched
+      recursively).  If none given, file names are read from the standard
+      input, e.g.
+         ls /data/mseed/BABY1601?? | msleapfix -e 2016/01/01T03:10
+      or a whole pool at once:
+         msleapfix -w tears.txt /data/mseed
+
+   Times are given as yyyy/mm/dd[Thh:mm[:ss[.fff]]].  The time of each
+   record's first sample decides whether it is in a tear; the record
+   spanning the leap second is flagged in its activity flags (bit 4 for a
+   positive leap second, bit 5 for negative).  A record put back into a
+   positive leap second gets the time 23:59:60.  Only the BTIME and activity
+   flags of the records changed are rewritten, so a pool may be fixed in
+   place reading only record headers and writing a few bytes of the records
+   in each tear.  The record size is taken from each record's blockette
+   1000, so files of any (or mixed) record size may be fixed.  Output lines
+   are
+
+      <file> <records> records <shifted> shifted <flagged> flagged
+
+   Compressed files (tv3mseed -c) are skipped; use mszcat first.
+*/
+
+#define _GNU_SOURCE                /* For nftw FTW_PHYS */
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <ftw.h>
+#include <errno.h>
+#include <libgen.h>
+#include <sys/stat.h>
+#include <pthread.h>
+#include "msrec.h"
+
+#define SEC 1000000000ll
+#define CHUNK 0x100000
+
+char *prog;
+
+short verb = 0, dry = 0;
+
+int lrdef = 0;
+char *odir = NULL;
+
+/* A time tear:  records of station sta starting in [t0, t1) are moved by
+   dt;  the leap second is at leap (the time the second after it starts) */
+struct tear {
+   char sta[6];
+   int64_t t0, t1, leap, dt;
+   int dir;
+};
+
+struct tear *tears = NULL;
+size_t ntear = 0, mtear = 0;
+
+/* Per-file work */
+struct job {
+   char *fn;
+   char *rel;                      /* Name below -o directory */
+   long long nrec, nshift, nflag;
+   int bad;
+};
+
+struct job *jobs = NULL;
+size_t njob = 0, mjob = 0, jnext = 0;
+pthread_mutex_t jlock = PTHREAD_MUTEX_INITIALIZER;
+
+void usage(){
+   char *msg =
+   " {-h | -v | -n | -b <size> | -j <n> | -l {+1|-1} | -s <time> |\n"
+   "      -e <time> | -w <file> | -o <dir>} ... [<file|dir> ...]\n"
+   " Options:\n"
+   "   -h - usage (this text)\n"
+   "   -v - verbose output (report unchanged files too)\n"
+   "   -n - only report what would be changed\n"
+   "   -b <size> - record size if no blockette 1000 in record\n"
+   "   -j <n> - number of parallel workers (default: # CPUs)\n"
+   "   -l +1 or -1 - sense of leap second for following -s/-e (default +1)\n"
+   "   -e <time> - end of tear after preceding leap second (Taurus v3)\n"
+   "   -s <time> - start of tear before following leap second (Taurus v2)\n"
+   "   -w <file> - tears by station:  <sta> {s|e} <time> [+1|-1]\n"
+   "   -o <dir> - write fixed files in a tree under <dir>, not in place\n"
+   "   <file|dir> ... - files or directories to fix (std. input if none)\n";
+   fprintf(stderr, "Usage: %s%s", prog, msg);
+   fflush(stderr);
+}
+
+void err(char *msg){
+   fprintf(stderr, "%s: %s\n", prog, msg); fflush(stderr);
+   exit(1);
+}
+
+void *grow(void *p, size_t *max, size_t need, size_t siz){
+   if (need <= *max) return p;
+   *max = need > 2*(*max) ? need : 2*(*max);
+   p = realloc(p, *max * siz);
+   if (p == NULL) err("out of memory");
+   return p;
+}
+
+/* Add a tear for station sta with start (s) or end (e) time t */
+
+int addtear(char *sta, char se, char *t, int dir){
+   struct tear *w;
+   struct tm tm;
+   time_t sec;
+   int64_t tns;
+   int yr, jul;
+
+   if (mstime(t, &tns) || (se != 's' && se != 'e') || strlen(sta) > 5)
+      return -1;
+   sec = tns/SEC;
+   gmtime_r(&sec, &tm);
+   yr = 1900+tm.tm_year;
+   jul = 182 + (yr%4 == 0 && (yr%100 != 0 || yr%400 == 0));
+   tears = grow(tears, &mtear, ntear+1, sizeof(struct tear));
+   w = tears + ntear++;
+   strcpy(w->sta, sta);
+   w->dir = dir;
+   w->dt = -dir*SEC;
+   /* Leap second at the end of 30 June or 31 Dec.:  before the end time,
+      after the start time */
+   if (se == 'e')
+      w->leap = tm.tm_mon < 6 ? mstns(yr, 1, 0, 0, 0, 0) :
+         mstns(yr, jul, 0, 0, 0, 0);
+   else
+      w->leap = tm.tm_mon < 6 ? mstns(yr, jul, 0, 0, 0, 0) :
+         mstns(yr+1, 1, 0, 0, 0, 0);
+   if (dir < 0) w->leap -= SEC;    /* 23:59:59 is skipped */
+   w->t0 = se == 'e' ? w->leap : tns;
+   w->t1 = se == 'e' ? tns : w->leap;
+   return 0;
+}
+
+void rdtears(char *fn){
+   FILE *fd = fopen(fn, "r");
+   char line[256], sta[16], se[4], t[64], d[8];
+   int n, lno = 0;
+
+   if (fd == NULL) err("can't open -w file");
+   while (fgets(line, sizeof(line), fd)) {
+      lno += 1;
+      if (line[0] == '#') continue;
+      n = sscanf(line, "%15s %3s %63s %7s", sta, se, t, d);
+      if (n <= 0) continue;
+      if (n < 3 || se[1] || addtear(sta, se[0], t, n < 4 ? 1 : atoi(d))
+       || (n == 4 && strcmp(d, "+1") && strcmp(d, "-1"))) {
+         fprintf(stderr, "%s: %s line %d: %s", prog, fn, lno, line);
+	 err("bad -w file line");
+      }
+   }
+   fclose(fd);
+}
+
+/* Make the directories leading to a file name */
+
+int mkdirs(char *fn){
+   char *p;
+
+   for(p=strchr(fn+1, '/'); p; p=strchr(p+1, '/')) {
+      *p = 0;
+      if (mkdir(fn, 0777) && errno != EEXIST) {*p = '/'; return -1;}
+      *p = '/';
+   }
+   return 0;
+}
+
+/* Apply the tears to one record header.  Returns 1 if shifted, 2 if
+   flagged (or both), 0 if left alone. */
+
+int fixrec(unsigned char *rec, struct mshdr *h){
+   int64_t tns = h->tns, end;
+   int i, what = 0;
+   unsigned char aflg = rec[36];
+
+   for(i=0; i<ntear; i++) {
+      struct tear *w = tears+i;
+      if (w->sta[0] != '*' && strcmp(w->sta, h->sta)) continue;
+      if (0 == (what & 1) && h->tns >= w->t0 && h->tns < w->t1) {
+         tns = h->tns + w->dt;
+	 what |= 1;
+      }
+   }
+   for(i=0; i<ntear; i++) {
+      struct tear *w = tears+i;
+      if (w->sta[0] != '*' && strcmp(w->sta, h->sta)) continue;
+      end = tns + (msend(h) - h->tns);
+      if (tns <= w->leap && end >= w->leap)
+         aflg = (aflg & ~0x30) | (w->dir > 0 ? 0x10 : 0x20);
+   }
+   if (what & 1) {
+      msput(rec, h, tns);
+      for(i=0; i<ntear; i++)       /* Put back into a positive leap second */
+         if (tears[i].dir > 0 && tns >= tears[i].leap - SEC
+	  && tns < tears[i].leap
+	  && (tears[i].sta[0] == '*' || 0 == strcmp(tears[i].sta, h->sta)))
+	    rec[26] = 60;
+   }
+   if (aflg != rec[36]) {
+      rec[36] = aflg;
+      what |= 2;
+   }
+   return what;
+}
+
+/* Copy bytes [from, to) of file fd to out (to < 0 for the rest) */
+
+void copy(int fd, off_t from, off_t to, FILE *out, unsigned char *buf){
+   ssize_t got;
+
+   while (to < 0 || from < to) {
+      got = pread(fd, buf, to < 0 || to-from > CHUNK ? CHUNK : to-from, from);
+      if (got < 0) err("error reading file");
+      if (got == 0) break;
+      if (1 != fwrite(buf, got, 1, out)) err("error writing fixed file");
+      from += got;
+   }
+}
+
+/* Fix one file, in place or into the -o tree.  In the tree, the file is
+   only written once there is something to change, and linked otherwise. */
+
+void fix(struct job *j, unsigned char *buf){
+   struct mshdr h;
+   FILE *out = NULL;
+   char *ofn = NULL;
+   size_t len = 0, pos = 0;
+   off_t off = 0, done = 0;
+   int fd, lrecl, what, mod = 0;
+
+   fd = open(j->fn, odir || dry ? O_RDONLY : O_RDWR);
+   if (fd < 0) {
+      fprintf(stderr, "%s: can't open %s, skipped\n", prog, j->fn);
+      j->bad = 1;
+      return;
+   }
+   if (odir) {
+      ofn = malloc(strlen(odir) + strlen(j->rel) + 2);
+      if (ofn == NULL) err("out of memory");
+      sprintf(ofn, "%s/%s", odir, j->rel);
+      if (!dry && mkdirs(ofn)) {
+	 fprintf(stderr, "%s: can't make directory for %s\n", prog, ofn);
+	 j->bad = 1;
+	 goto done;
+      }
+   }
+   for(;;) {
+      if (len-pos < MSMAXREC) {
+         memmove(buf, buf+pos, len-pos); len -= pos; pos = 0;
+	 while (len < CHUNK) {
+	    ssize_t got = read(fd, buf+len, CHUNK+MSMAXREC-len);
+	    if (got <= 0) break;
+	    len += got;
+	 }
+      }
+      if (len-pos < 128) break;
+      if (msdec(buf+pos, &h)) {
+         fprintf(stderr, "%s: %s at offset %llx: not a data record, "
+	    "rest of file %s\n", prog, j->fn, (unsigned long long)off,
+	    out ? "copied" : "skipped");
+	 j->bad = 1;
+	 break;
+      }
+      lrecl = h.lrecl ? h.lrecl : lrdef;
+      if (lrecl <= 0 || lrecl > len-pos) {
+         fprintf(stderr, "%s: %s at offset %llx: %s, rest of file %s\n",
+	    prog, j->fn, (unsigned long long)off, lrecl <= 0 ?
+	    "no blockette 1000, use -b" : "short record",
+	    out ? "copied" : "skipped");
+	 j->bad = 1;
+	 break;
+      }
+      j->nrec += 1;
+      what = fixrec(buf+pos, &h);
+      if (what & 1) j->nshift += 1;
+      if (what & 2) j->nflag += 1;
+      if (what && !dry) {
+         mod = 1;
+         if (odir && out == NULL) {
+	    /* First change:  copy what came before */
+	    int ofd = open(ofn, O_WRONLY|O_CREAT|O_EXCL, 0666);
+	    if (ofd < 0 || NULL == (out = fdopen(ofd, "w"))) {
+	       fprintf(stderr, "%s: can't make %s, %s skipped\n", prog, ofn,
+	          j->fn);
+	       j->bad = 1;
+	       goto done;
+	    }
+	    setvbuf(out, NULL, _IOFBF, CHUNK);
+	    copy(fd, 0, off, out, buf+CHUNK+MSMAXREC);
+	 } else if (!odir) {
+	    /* In place:  only the header bytes from BTIME to the activity
+	       flags are rewritten */
+	    if (17 != pwrite(fd, buf+pos+20, 17, off+20))
+	       err("error rewriting record header");
+	 }
+      }
+      if (out && 1 != fwrite(buf+pos, lrecl, 1, out))
+         err("error writing fixed file");
+      off += lrecl; pos += lrecl;
+   }
+   done = off;
+   if (out) {
+      copy(fd, done, -1, out, buf+CHUNK+MSMAXREC);
+      if (fclose(out)) err("error writing fixed file");
+   } else if (odir && !dry && !j->bad && link(j->fn, ofn)) {
+      /* Nothing to change:  link (or copy) the file into the tree */
+      int ofd = open(ofn, O_WRONLY|O_CREAT|O_EXCL, 0666);
+      if (ofd < 0 || NULL == (out = fdopen(ofd, "w"))) {
+	 fprintf(stderr, "%s: can't make %s\n", prog, ofn);
+	 j->bad = 1;
+      } else {
+         copy(fd, 0, -1, out, buf);
+	 if (fclose(out)) err("error copying file");
+      }
+   }
+   if (mod && !odir && fsync(fd)) err("error rewriting record header");
+done:
+   close(fd);
+   free(ofn);
+}
+
+void *worker(void *arg){
+   unsigned char *buf = malloc(2*CHUNK+MSMAXREC);
+   size_t i;
+
+   if (buf == NULL) err("out of memory");
+   for(;;) {
+      pthread_mutex_lock(&jlock);
+      i = jnext++;
+      pthread_mutex_unlock(&jlock);
+      if (i >= njob) break;
+      fix(jobs+i, buf);
+   }
+   free(buf);
+   return NULL;
+}
+
+void addjob(char *fn, char *rel){
+   jobs = grow(jobs, &mjob, njob+1, sizeof(struct job));
+   memset(jobs+njob, 0, sizeof(struct job));
+   jobs[njob].fn = fn;
+   jobs[njob++].rel = rel;
+}
+
+/* Files in a directory tree given on the command line */
+
+size_t dirlen;
+
+int walk(const char *fn, const struct stat *sb, int flag, struct FTW *ftw){
+   char *p;
+   if (flag != FTW_F || !S_ISREG(sb->st_mode)) return 0;
+   p = strdup(fn);
+   if (p == NULL) err("out of memory");
+   addjob(p, p+dirlen);
+   return 0;
+}
+
+void addarg(char *fn){
+   struct stat sb;
+
+   if (0 == stat(fn, &sb) && S_ISDIR(sb.st_mode)) {
+      dirlen = strlen(fn);
+      while (dirlen > 1 && fn[dirlen-1] == '/') dirlen--;
+      dirlen += 1;
+      if (nftw(fn, walk, 32, FTW_PHYS)) err("can't search directory");
+   } else {
+      char *p = strdup(fn), *q = strdup(fn);
+      if (p == NULL || q == NULL) err("out of memory");
+      addjob(p, basename(q));
+   }
+}
+
+int main(int argc, char *argv[]){
+   pthread_t *tid;
+   size_t j;
+   int i, nthr = 0, dir = 1, nfix = 0, nbad = 0;
+   long ncpu;
+   char line[4096];
+
+   prog = argv[0];
+
+   for(i=1; i<argc; i++) {
+      if (argv[i][0] == '-' && argv[i][1]) { /* Check for option */
+         if (i+1 < argc && 0 == strcmp(argv[i], "-b")) {
+	    char *p;
+	    lrdef = strtol(argv[++i], &p, 10);
+	    if (*p || lrdef < 128 || lrdef > MSMAXREC) err("bad -b value");
+         } else if (i+1 < argc && 0 == strcmp(argv[i], "-j")) {
+	    char *p;
+	    nthr = strtol(argv[++i], &p, 10);
+	    if (*p || nthr < 1) err("bad -j value");
+         } else if (i+1 < argc && 0 == strcmp(argv[i], "-l")) {
+	    i += 1;
+	    if (0 == strcmp(argv[i], "+1") || 0 == strcmp(argv[i], "1"))
+	       dir = 1;
+	    else if (0 == strcmp(argv[i], "-1"))
+	       dir = -1;
+	    else
+	       err("bad -l value");
+         } else if (i+1 < argc && (0 == strcmp(argv[i], "-s")
+	                        || 0 == strcmp(argv[i], "-e"))) {
+	    if (addtear("*", argv[i][1], argv[i+1], dir))
+	       err(argv[i][1] == 's' ? "bad -s time" : "bad -e time");
+	    i += 1;
+         } else if (i+1 < argc && 0 == strcmp(argv[i], "-w")) {
+	    rdtears(argv[++i]);
+         } else if (i+1 < argc && 0 == strcmp(argv[i], "-o")) {
+	    odir = argv[++i];
+         } else if (0 == strcmp(argv[i], "-n")) {
+	    dry = 1;
+         } else if (0 == strcmp(argv[i], "-v")) {
+	    verb = 1;
+         } else if (0 == strcmp(argv[i], "-h")) {
+	    usage();
+	 } else {
+	    fprintf(stderr, "bad arg (ignored): %s\n", argv[i]);
+	 }
+      } else {
+         addarg(argv[i]);
+      }
+   }
+   if (ntear == 0) err("no -s, -e or -w time tears given");
+   if (njob == 0) {
+      while (fgets(line, sizeof(line), stdin)) {
+         line[strcspn(line, "\n")] = 0;
+	 if (line[0] == 0) continue;
+	 addarg(line);
+      }
+   }
+   if (njob == 0) err("no files to fix");
+   if (odir && mkdir(odir, 0777) && errno != EEXIST)
+      err("can't make -o directory");
+
+   /* Fix files in parallel */
+   ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+   if (nthr == 0) nthr = ncpu > 0 ? ncpu : 1;
+   if (nthr > njob) nthr = njob;
+   tid = malloc(nthr*sizeof(pthread_t));
+   if (tid == NULL) err("out of memory");
+   for(i=0;i<nthr;i++)
+      if (pthread_create(tid+i, NULL, worker, NULL)) err("can't start thread");
+   for(i=0;i<nthr;i++) pthread_join(tid[i], NULL);
+
+   for(j=0; j<njob; j++) {
+      struct job *f = jobs+j;
+      if (f->nshift || f->nflag) nfix += 1;
+      if (f->bad) nbad += 1;
+      if (verb || f->nshift || f->nflag)
+         printf("%s %lld records %lld shifted %lld flagged\n", f->fn,
+	    f->nrec, f->nshift, f->nflag);
+   }
+   if (verb) fprintf(stderr, "%s: %zu files, %d %s, %d with errors\n",
+      prog, njob, nfix, dry ? "to fix" : "fixed", nbad);
+   return nbad ? 1 : 0;
+}
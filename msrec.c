@@ -0,0 +1,165 @@
+/* MSEED record header decoding shared by the C archive tools.
+
+   Records may be in either byte order; as in the Fortran tools, the order is
+   decided by whether the BTIME year makes sense big-endian.  Times are kept as
+   nanoseconds from 1970 so that they compare and subtract simply.
+
+   G. Helffrich/U. Bristol
+      18 Oct. 2026
+*/
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "msrec.h"
+
+static int u16(unsigned char *p, int swap){
+   return swap ? (p[1] << 8) | p[0] : (p[0] << 8) | p[1];
+}
+
+static int s16(unsigned char *p, int swap){
+   return (short)u16(p, swap);
+}
+
+static int s32(unsigned char *p, int swap){
+   if (swap) return (p[3] << 24) | (p[2] << 16) | (p[1] << 8) | p[0];
+   return (p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+}
+
+static void p16(unsigned char *p, int v, int swap){
+   p[swap?1:0] = (v >> 8) & 0xff; p[swap?0:1] = v & 0xff;
+}
+
+/* Copy a blank-padded header field, dropping trailing blanks */
+
+static void field(char *dst, unsigned char *src, int n){
+   memcpy(dst, src, n); dst[n] = 0;
+   while (n > 0 && dst[n-1] == ' ') dst[--n] = 0;
+}
+
+/* Days from 1970/01/01 to the given date (proleptic Gregorian) */
+
+static int64_t days(int yr, int mo, int dy){
+   int64_t era, yoe, doy;
+   yr -= mo <= 2;
+   era = (yr >= 0 ? yr : yr-399) / 400;
+   yoe = yr - era*400;
+   doy = (153*(mo + (mo > 2 ? -3 : 9)) + 2)/5 + dy-1;
+   return era*146097 + yoe*365 + yoe/4 - yoe/100 + doy - 719468;
+}
+
+int64_t mstns(int yr, int jday, int hr, int mn, int sc, long ns){
+   int64_t d = days(yr, 1, 1) + jday-1;
+   return (((d*24 + hr)*60 + mn)*60 + sc)*1000000000ll + ns;
+}
+
+/* Decode record header.  rec must hold at least the first 128 bytes of the
+   record.  Returns 0 if a data record, -1 if not. */
+
+int msdec(unsigned char *rec, struct mshdr *h){
+   int i, yr, b, nb;
+
+   if (rec[6] == 0 || NULL == strchr("DRQM", rec[6])) return -1;
+   h->type = rec[6];
+   h->seq = 0;
+   for(i=0;i<6;i++){
+      if (rec[i] < '0' || rec[i] > '9') {h->seq = -1; break;}
+      h->seq = 10*h->seq + rec[i]-'0';
+   }
+   field(h->sta, rec+8, 5);
+   field(h->loc, rec+13, 2);
+   field(h->chn, rec+15, 3);
+   field(h->net, rec+18, 2);
+
+   yr = u16(rec+20, 0);
+   h->swap = yr < 1900 || yr > 2500;
+   if (h->swap) yr = u16(rec+20, 1);
+   if (yr < 1900 || yr > 2500) return -1;
+   h->tns = mstns(yr, u16(rec+22, h->swap), rec[24], rec[25], rec[26],
+      100000l*u16(rec+28, h->swap));
+   h->nsamp = u16(rec+30, h->swap);
+   h->srf = s16(rec+32, h->swap); h->srm = s16(rec+34, h->swap);
+   h->rate = (h->srf>0 && h->srm>0) ? (double)h->srf*h->srm :
+             (h->srf>0 && h->srm<0) ? -(double)h->srf/h->srm :
+             (h->srf<0 && h->srm>0) ? -(double)h->srm/h->srf :
+             (h->srf<0 && h->srm<0) ? 1/((double)h->srf*h->srm) : 0;
+   h->aflg = rec[36]; h->iflg = rec[37]; h->qflg = rec[38];
+
+   /* Time correction, unless flagged as already applied */
+   if (0 == (h->aflg & 0x02)) h->tns += 100000ll*s32(rec+40, h->swap);
+
+   /* Follow blockette chain looking for type 1000 record length */
+   h->lrecl = 0;
+   for(b=u16(rec+46, h->swap), nb=0; b >= 48 && b+8 <= 128 && nb < rec[39];
+       b=u16(rec+b+2, h->swap), nb++) {
+      if (u16(rec+b, h->swap) == 1000) {
+         if (rec[b+6] >= 7 && 1<<rec[b+6] <= MSMAXREC) h->lrecl = 1<<rec[b+6];
+	 break;
+      }
+   }
+   return 0;
+}
+
+/* Time following the last sample in the record */
+
+int64_t msend(struct mshdr *h){
+   if (h->rate <= 0) return h->tns;
+   return h->tns + (int64_t)(1e9*h->nsamp/h->rate + 0.5);
+}
+
+/* Rewrite BTIME of a record to a new time, keeping its byte order.  Any time
+   correction in the header is taken as still to be applied. */
+
+void msput(unsigned char *rec, struct mshdr *h, int64_t tns){
+   time_t t;
+   struct tm tm;
+
+   if (0 == (h->aflg & 0x02)) tns -= 100000ll*s32(rec+40, h->swap);
+   t = tns/1000000000ll;
+   gmtime_r(&t, &tm);
+   p16(rec+20, 1900+tm.tm_year, h->swap);
+   p16(rec+22, 1+tm.tm_yday, h->swap);
+   rec[24] = tm.tm_hour; rec[25] = tm.tm_min; rec[26] = tm.tm_sec;
+   p16(rec+28, (tns%1000000000ll)/100000, h->swap);
+}
+
+/* Stream ID as NET.STA.LOC.CHN */
+
+void mssid(struct mshdr *h, char *sid){
+   sprintf(sid, "%s.%s.%s.%s", h->net, h->sta, h->loc, h->chn);
+}
+
+/* Parse time given as yyyy/mm/dd[{T|,| }hh:mm[:ss[.fff]]].  Returns 0 if OK,
+   -1 if not understood. */
+
+int mstime(char *str, int64_t *tns){
+   int yr, mo, dy, hr = 0, mn = 0, n;
+   double sc = 0;
+   char sep;
+
+   n = sscanf(str, "%d/%d/%d%c%d:%d:%lf", &yr, &mo, &dy, &sep, &hr, &mn, &sc);
+   if (n < 3) return -1;
+   if (n > 3 && n < 6) return -1;
+   if (n > 3 && NULL == strchr("T, ", sep)) return -1;
+   if (mo < 1 || mo > 12 || dy < 1 || dy > 31) return -1;
+   if (hr < 0 || hr > 23 || mn < 0 || mn > 59 || sc < 0 || sc >= 61) return -1;
+   *tns = (((days(yr, mo, dy)*24 + hr)*60 + mn)*60)*1000000000ll
+        + (int64_t)(sc*1e9 + 0.5);
+   return 0;
+}
+
+/* Format time as yyyy/mm/dd hh:mm:ss.ffff */
+
+void msfmt(int64_t tns, char *str){
+   time_t t = tns/1000000000ll;
+   int64_t f = tns%1000000000ll;
+   struct tm tm;
+
+   if (f < 0) t -= 1, f += 1000000000ll;
+   gmtime_r(&t, &tm);
+   sprintf(str, "%04d/%02d/%02d %02d:%02d:%02d.%04d",
+      1900+tm.tm_year, 1+tm.tm_mon, tm.tm_mday,
+      tm.tm_hour, tm.tm_min, tm.tm_sec, (int)(f/100000));
+}
@@ -0,0 +1,32 @@
+/* Declarations for msrec.c, MSEED record header decoding shared by the C
+   archive tools.
+
+   G. Helffrich/U. Bristol
+      18 Oct. 2026
+*/
+
+#include <stdint.h>
+
+#define MSMAXREC 65536             /* Largest record length handled */
+
+/* Decoded fixed header of a data record */
+struct mshdr {
+   int seq;                        /* Sequence number, -1 if not numeric */
+   char type;                      /* D, R, Q or M */
+   char sta[6], loc[3], chn[4], net[3];
+   int64_t tns;                    /* Time of first sample, ns from 1970 */
+   int nsamp;                      /* Number of samples */
+   int srf, srm;                   /* Sample rate factor, multiplier */
+   double rate;                    /* Samples/s (0 if not known) */
+   int lrecl;                      /* Record length from bkette 1000, or 0 */
+   int swap;                       /* Header is little-endian */
+   unsigned char aflg, iflg, qflg; /* Activity, I/O & clock, quality flags */
+};
+
+int msdec(unsigned char *rec, struct mshdr *h);
+int64_t msend(struct mshdr *h);
+void msput(unsigned char *rec, struct mshdr *h, int64_t tns);
+void mssid(struct mshdr *h, char *sid);
+int64_t mstns(int yr, int jday, int hr, int mn, int sc, long ns);
+int mstime(char *str, int64_t *tns);
+void msfmt(int64_t tns, char *str);
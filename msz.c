@@ -0,0 +1,466 @@
+/* Compressed MSEED record files.
+
+   Records are gathered into frames of MSZFR records that are each compressed
+   independently with zlib, so that any record may be got at by decompressing
+   only the frame that holds it.  File layout (integers little-endian):
+
+      "MSZ1" lrecl(4) records-per-frame(4) 0(4)
+      frame:  compressed-length(4) uncompressed-length(4) data ...
+      ...
+      0(4) 0(4)                      - end of frames
+      frame offsets(8) ...           - index
+      index-offset(8) frames(8) uncompressed-bytes(8) "MSZX" 0(4)
+
+   Every frame but the last is full, so the frame holding any byte of the
+   uncompressed data is known by division.  A reader on a pipe uses the
+   frame headers alone; a reader with a seekable file uses the index at the
+   end (or rebuilds it from the frame headers if the writer died before
+   writing it).  Files that aren't compressed are read as they are, so that
+   tools reading through these routines take either kind of file.
+
+   G. Helffrich/U. Bristol
+      18 Oct. 2026
+*/
+
+#define _GNU_SOURCE                /* For fopencookie */
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <zlib.h>
+#include "msz.h"
+#include "msrec.h"
+
+#define MSZHDR 16                  /* File header size */
+#define MSZTRL 32                  /* File trailer size */
+#define MSZLEV 1                   /* zlib compression level */
+#define MSZFT 32                   /* Fortran handle table size */
+
+static void p32(unsigned char *p, uint32_t v){
+   p[0] = v; p[1] = v >> 8; p[2] = v >> 16; p[3] = v >> 24;
+}
+
+static void p64(unsigned char *p, uint64_t v){
+   p32(p, v); p32(p+4, v >> 32);
+}
+
+static uint32_t g32(unsigned char *p){
+   return p[0] | p[1] << 8 | p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+static uint64_t g64(unsigned char *p){
+   return g32(p) | (uint64_t)g32(p+4) << 32;
+}
+
+/* Writer.  Output goes through a stdio stream so that the writing program
+   needn't know that it is compressing. */
+
+struct mszw {
+   FILE *fd;
+   size_t fsz, n;                  /* Frame size, bytes now in frame */
+   unsigned char *ubuf, *cbuf;
+   uLong cmax;
+   uint64_t *idx, off, tot;
+   size_t nfr, mfr;
+};
+
+static int emit(struct mszw *w){
+   unsigned char fh[8];
+   uLongf clen = w->cmax;
+
+   if (w->n == 0) return 0;
+   if (Z_OK != compress2(w->cbuf, &clen, w->ubuf, w->n, MSZLEV)) return -1;
+   if (w->nfr >= w->mfr) {
+      w->mfr = w->mfr ? 2*w->mfr : 1024;
+      w->idx = realloc(w->idx, w->mfr*sizeof(uint64_t));
+      if (w->idx == NULL) return -1;
+   }
+   w->idx[w->nfr++] = w->off;
+   p32(fh, clen); p32(fh+4, w->n);
+   if (1 != fwrite(fh, sizeof(fh), 1, w->fd)) return -1;
+   if (1 != fwrite(w->cbuf, clen, 1, w->fd)) return -1;
+   w->off += sizeof(fh) + clen; w->tot += w->n; w->n = 0;
+   return 0;
+}
+
+static ssize_t wwrite(void *cookie, const char *buf, size_t size){
+   struct mszw *w = cookie;
+   size_t left = size, k;
+
+   while (left > 0) {
+      k = w->fsz - w->n; if (k > left) k = left;
+      memcpy(w->ubuf + w->n, buf, k);
+      w->n += k; buf += k; left -= k;
+      if (w->n == w->fsz && emit(w)) return -1;
+   }
+   return size;
+}
+
+static int wclose(void *cookie){
+   struct mszw *w = cookie;
+   unsigned char b[MSZTRL];
+   size_t i;
+   int rc = emit(w);
+
+   memset(b, 0, 8);
+   if (1 != fwrite(b, 8, 1, w->fd)) rc = -1;
+   for(i=0; i<w->nfr; i++) {
+      p64(b, w->idx[i]);
+      if (1 != fwrite(b, 8, 1, w->fd)) rc = -1;
+   }
+   p64(b, w->off+8); p64(b+8, w->nfr); p64(b+16, w->tot);
+   memcpy(b+24, "MSZX", 4); p32(b+28, 0);
+   if (1 != fwrite(b, MSZTRL, 1, w->fd)) rc = -1;
+   if (fclose(w->fd)) rc = -1;
+   free(w->ubuf); free(w->cbuf); free(w->idx); free(w);
+   return rc;
+}
+
+#if defined(__APPLE__) || defined(__FreeBSD__)
+static int fwrt(void *cookie, const char *buf, int size){
+   return wwrite(cookie, buf, size);
+}
+#endif
+
+/* Return a stream that writes compressed records to fd.  Closing the stream
+   finishes the file and closes fd. */
+
+FILE *mszout(FILE *fd, int lrecl){
+   struct mszw *w = calloc(1, sizeof(struct mszw));
+   unsigned char hdr[MSZHDR];
+   FILE *zfd;
+
+   if (w == NULL) return NULL;
+   w->fd = fd;
+   w->fsz = (size_t)MSZFR*lrecl;
+   w->cmax = compressBound(w->fsz);
+   w->ubuf = malloc(w->fsz); w->cbuf = malloc(w->cmax);
+   if (w->ubuf == NULL || w->cbuf == NULL) return NULL;
+   memcpy(hdr, "MSZ1", 4); p32(hdr+4, lrecl); p32(hdr+8, MSZFR); p32(hdr+12, 0);
+   if (1 != fwrite(hdr, MSZHDR, 1, fd)) return NULL;
+   w->off = MSZHDR;
+#if defined(__APPLE__) || defined(__FreeBSD__)
+   zfd = funopen(w, NULL, fwrt, NULL, wclose);
+#else
+   {
+      cookie_io_functions_t io = {NULL, wwrite, NULL, wclose};
+      zfd = fopencookie(w, "w", io);
+   }
+#endif
+   return zfd;
+}
+
+/* Reader */
+
+struct msz {
+   int fd, cmp, seek;
+   unsigned char pre[MSZHDR];      /* Bytes read while checking a pipe */
+   int npre, ipre;
+   size_t fsz;                     /* Full frame size (uncompressed) */
+   unsigned char *fbuf, *cbuf;     /* Frame, compressed frame */
+   size_t flen, fpos, cmax;
+   int64_t fno;                    /* Frame in fbuf, or -1 */
+   uint64_t *idx;                  /* Frame offsets */
+   int64_t nfr;                    /* Frames, or -1 if no index yet */
+};
+
+static ssize_t rdfull(int fd, void *buf, size_t n){
+   size_t got = 0;
+   ssize_t k;
+   while (got < n) {
+      k = read(fd, (char *)buf + got, n - got);
+      if (k <= 0) break;
+      got += k;
+   }
+   return got;
+}
+
+static ssize_t prdfull(int fd, void *buf, size_t n, off_t off){
+   size_t got = 0;
+   ssize_t k;
+   while (got < n) {
+      k = pread(fd, (char *)buf + got, n - got, off + got);
+      if (k <= 0) break;
+      got += k;
+   }
+   return got;
+}
+
+/* Read file open on fd, compressed or not */
+
+struct msz *mszfd(int fd){
+   struct msz *z = calloc(1, sizeof(struct msz));
+   struct stat sb;
+   unsigned char *h;
+
+   if (z == NULL) return NULL;
+   z->fd = fd; z->fno = -1; z->nfr = -1;
+   z->seek = 0 == fstat(fd, &sb) && S_ISREG(sb.st_mode);
+   h = z->pre;
+   if (z->seek)
+      z->npre = prdfull(fd, h, MSZHDR, 0);
+   else
+      z->npre = rdfull(fd, h, MSZHDR);
+   if (z->npre == MSZHDR && 0 == memcmp(h, "MSZ1", 4)) {
+      z->cmp = 1;
+      z->fsz = (size_t)g32(h+4)*g32(h+8);
+      z->fbuf = malloc(z->fsz);
+      if (z->fbuf == NULL) {free(z); return NULL;}
+      if (z->seek) (void)lseek(fd, MSZHDR, SEEK_SET);
+   }
+   if (z->cmp || z->seek) z->npre = 0;
+   return z;
+}
+
+int mszcmp(struct msz *z){
+   return z->cmp;
+}
+
+/* Decompress frame whose compressed data is in cbuf */
+
+static int unpack(struct msz *z, uint32_t clen, uint32_t ulen){
+   uLongf n = z->fsz;
+   if (ulen > z->fsz) return -1;
+   if (Z_OK != uncompress(z->fbuf, &n, z->cbuf, clen) || n != ulen) return -1;
+   z->flen = n; z->fpos = 0;
+   return 0;
+}
+
+static int cbsize(struct msz *z, uint32_t clen){
+   if (clen <= z->cmax) return 0;
+   z->cbuf = realloc(z->cbuf, clen);
+   if (z->cbuf == NULL) return -1;
+   z->cmax = clen;
+   return 0;
+}
+
+/* Next frame of a sequentially-read file */
+
+static int nextfr(struct msz *z){
+   unsigned char fh[8];
+   uint32_t clen;
+
+   if (8 != rdfull(z->fd, fh, 8)) return -1;
+   clen = g32(fh);
+   if (clen == 0 || cbsize(z, clen)) return -1;
+   if (clen != rdfull(z->fd, z->cbuf, clen)) return -1;
+   z->fno = -1;
+   return unpack(z, clen, g32(fh+4));
+}
+
+/* Load frame index from the trailer, or by following the frame headers */
+
+static int ldidx(struct msz *z){
+   unsigned char b[MSZTRL];
+   struct stat sb;
+   uint64_t ioff, n, i, off;
+   int64_t m = 0;
+
+   if (fstat(z->fd, &sb)) return -1;
+   if (sb.st_size >= MSZHDR+8+MSZTRL &&
+       MSZTRL == prdfull(z->fd, b, MSZTRL, sb.st_size-MSZTRL) &&
+       0 == memcmp(b+24, "MSZX", 4)) {
+      ioff = g64(b); n = g64(b+8);
+      if (ioff + 8*n + MSZTRL == sb.st_size) {
+         z->idx = malloc((n ? n : 1)*sizeof(uint64_t));
+	 if (z->idx == NULL) return -1;
+	 for(i=0; i<n; i++) {
+	    if (8 != prdfull(z->fd, b, 8, ioff + 8*i)) return -1;
+	    z->idx[i] = g64(b);
+	 }
+	 z->nfr = n;
+	 return 0;
+      }
+   }
+   for(off=MSZHDR, z->nfr=0; 8 == prdfull(z->fd, b, 8, off); off += 8+g32(b)){
+      if (g32(b) == 0) break;
+      if (z->nfr >= m) {
+         m = m ? 2*m : 1024;
+	 z->idx = realloc(z->idx, m*sizeof(uint64_t));
+	 if (z->idx == NULL) return -1;
+      }
+      z->idx[z->nfr++] = off;
+   }
+   return 0;
+}
+
+static int getfr(struct msz *z, int64_t k){
+   unsigned char fh[8];
+   uint32_t clen;
+
+   if (z->fno == k) return 0;
+   if (8 != prdfull(z->fd, fh, 8, z->idx[k])) return -1;
+   clen = g32(fh);
+   if (cbsize(z, clen)) return -1;
+   if (clen != prdfull(z->fd, z->cbuf, clen, z->idx[k]+8)) return -1;
+   z->fno = -1;
+   if (unpack(z, clen, g32(fh+4))) return -1;
+   z->fno = k;
+   return 0;
+}
+
+/* Read n bytes of (uncompressed) data sequentially */
+
+ssize_t mszread(struct msz *z, void *buf, size_t n){
+   unsigned char *p = buf;
+   size_t got = 0, k;
+
+   if (!z->cmp) {
+      k = z->npre - z->ipre; if (k > n) k = n;
+      memcpy(p, z->pre + z->ipre, k); z->ipre += k;
+      return k + rdfull(z->fd, p+k, n-k);
+   }
+   while (got < n) {
+      if (z->fpos >= z->flen && nextfr(z)) break;
+      k = z->flen - z->fpos; if (k > n-got) k = n-got;
+      memcpy(p+got, z->fbuf + z->fpos, k);
+      z->fpos += k; got += k;
+   }
+   return got;
+}
+
+/* Read n bytes of (uncompressed) data starting at offset off.  Needs a
+   seekable file. */
+
+ssize_t mszpread(struct msz *z, void *buf, size_t n, uint64_t off){
+   unsigned char *p = buf;
+   size_t got = 0, k, o;
+   int64_t f;
+
+   if (!z->seek) return -1;
+   if (!z->cmp) return prdfull(z->fd, buf, n, off);
+   if (z->nfr < 0 && ldidx(z)) return -1;
+   while (got < n) {
+      f = (off+got)/z->fsz; o = (off+got)%z->fsz;
+      if (f >= z->nfr || getfr(z, f) || o >= z->flen) break;
+      k = z->flen - o; if (k > n-got) k = n-got;
+      memcpy(p+got, z->fbuf + o, k);
+      got += k;
+   }
+   return got;
+}
+
+void mszclose(struct msz *z){
+   if (z->fd) close(z->fd);
+   free(z->fbuf); free(z->cbuf); free(z->idx); free(z);
+}
+
+/* Fortran interface:
+
+      call mszopn(fn, iz, ios) - open file fn ('-' for std. input) returning
+         handle iz; ios nonzero if not opened.
+      call mszget(iz, nrec, lrecl, buf, ios) - read record nrec (from 1) of
+         length lrecl into buf; ios -1 at end of file, 1 if a read error or
+         out of order record requested from a pipe.
+      call mszrd(iz, nrec, lrdef, buf, lrecl, ios) - read record nrec (from
+         1) into buf, whatever its length:  the length is taken from the
+         record's blockette 1000, or is lrdef if it has none, and is
+         returned in lrecl.  Records may be up to MSMAXREC bytes long.  ios
+         as for mszget.
+      call mszcls(iz) - close file.
+
+   mszrd finds records by keeping the offset of each record it has passed;
+   a record beyond those known is found by reading the headers in between.
+*/
+
+static struct ftent {
+   struct msz *z;
+   int64_t next;
+   uint64_t *off;                  /* Offsets of records 1 ... noff */
+   int64_t noff, moff;
+   uint64_t pos;                   /* Offset following record noff */
+} ftab[MSZFT];
+
+void mszopn_(char *fn, int *iz, int *ios, size_t lfn){
+   char name[1024];
+   int i, fd;
+
+   *ios = 1;
+   while (lfn > 0 && fn[lfn-1] == ' ') lfn--;
+   if (lfn >= sizeof(name)) return;
+   memcpy(name, fn, lfn); name[lfn] = 0;
+   for(i=0; i<MSZFT && ftab[i].z; i++);
+   if (i >= MSZFT) return;
+   fd = strcmp(name, "-") ? open(name, O_RDONLY) : 0;
+   if (fd < 0) return;
+   ftab[i].z = mszfd(fd);
+   if (ftab[i].z == NULL) {if (fd) close(fd); return;}
+   ftab[i].next = 1;
+   ftab[i].noff = 0; ftab[i].pos = 0;
+   *iz = i+1; *ios = 0;
+}
+
+void mszget_(int *iz, int *nrec, int *lrecl, char *buf, int *ios, size_t lbuf){
+   struct msz *z = ftab[*iz-1].z;
+   ssize_t n;
+
+   if (z->seek)
+      n = mszpread(z, buf, *lrecl, (uint64_t)(*nrec-1) * *lrecl);
+   else if (*nrec == ftab[*iz-1].next)
+      n = mszread(z, buf, *lrecl);
+   else
+      n = -1;
+   if (n == *lrecl) ftab[*iz-1].next = *nrec + 1;
+   *ios = n == *lrecl ? 0 : n == 0 ? -1 : 1;
+}
+
+/* Length of record from its header */
+
+static int reclen(unsigned char *rec, int lrdef){
+   struct mshdr h;
+   if (msdec(rec, &h) || h.lrecl == 0) return lrdef;
+   return h.lrecl;
+}
+
+void mszrd_(int *iz, int *nrec, int *lrdef, char *buf, int *lrecl, int *ios,
+   size_t lbuf){
+   struct msz *z = ftab[*iz-1].z;
+   struct ftent *f = ftab + *iz-1;
+   unsigned char hdr[128];
+   ssize_t n;
+   int len = 0;
+
+   *ios = 1;
+   if (*nrec < 1) return;
+   if (z->seek) {
+      /* Find record's offset, reading headers of any not yet passed */
+      while (f->noff < *nrec) {
+         n = mszpread(z, hdr, sizeof(hdr), f->pos);
+	 if (n != sizeof(hdr)) {*ios = n == 0 ? -1 : 1; return;}
+	 len = reclen(hdr, *lrdef);
+	 if (len < (int)sizeof(hdr) || len > MSMAXREC) return;
+	 if (f->noff >= f->moff) {
+	    f->moff = f->moff ? 2*f->moff : 4096;
+	    f->off = realloc(f->off, f->moff*sizeof(uint64_t));
+	    if (f->off == NULL) return;
+	 }
+	 f->off[f->noff++] = f->pos;
+	 f->pos += len;
+      }
+      n = mszpread(z, hdr, sizeof(hdr), f->off[*nrec-1]);
+      if (n != sizeof(hdr)) return;
+      len = reclen(hdr, *lrdef);
+      if ((size_t)len > lbuf) return;
+      n = mszpread(z, buf, len, f->off[*nrec-1]);
+   } else if (*nrec == f->next) {
+      n = mszread(z, hdr, sizeof(hdr));
+      if (n != sizeof(hdr)) {*ios = n == 0 ? -1 : 1; return;}
+      len = reclen(hdr, *lrdef);
+      if (len < (int)sizeof(hdr) || (size_t)len > lbuf) return;
+      memcpy(buf, hdr, sizeof(hdr));
+      n = sizeof(hdr) + mszread(z, buf+sizeof(hdr), len-sizeof(hdr));
+   } else
+      return;
+   if (n != len) return;
+   f->next = *nrec + 1;
+   *lrecl = len; *ios = 0;
+}
+
+void mszcls_(int *iz){
+   mszclose(ftab[*iz-1].z);
+   free(ftab[*iz-1].off);
+   ftab[*iz-1].z = NULL; ftab[*iz-1].off = NULL; ftab[*iz-1].moff = 0;
+}
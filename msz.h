@@ -0,0 +1,20 @@
+/* Declarations for msz.c, compressed MSEED record files.
+
+   G. Helffrich/U. Bristol
+      18 Oct. 2026
+*/
+
+#include <stdio.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#define MSZFR 128                  /* Records per compressed frame */
+
+struct msz;
+
+FILE *mszout(FILE *fd, int lrecl);
+struct msz *mszfd(int fd);
+int mszcmp(struct msz *z);
+ssize_t mszread(struct msz *z, void *buf, size_t n);
+ssize_t mszpread(struct msz *z, void *buf, size_t n, uint64_t off);
+void mszclose(struct msz *z);
@@ -0,0 +1,100 @@
+/* Decompress (or compress) MSEED record files in the tv3mseed -c format.
+
+   G. Helffrich/U. Bristol
+      18 Oct. 2026
+
+Usage:  mszcat {-h | -c | -b <size>} ... [<file> ...]
+
+Command line parameters:
+   -h - usage (this text)
+   -c - compress rather than decompress
+   -b <size> - record size when compressing (default 512)
+   <file> ... - files to read, written one after the other to the standard
+      output.  If none given, or a file name is -, reads the standard input.
+
+   Decompression is for tools that don't read compressed files themselves
+   (rnmseed, mseedidx, the leap second fixers), e.g.
+      mszcat z.msz > z.dat
+   Uncompressed files are copied unchanged.  Compression turns an MSEED
+   file into one that mseedsort, splitseed and mseedgap read directly.
+*/
+
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include "msz.h"
+
+#define CHUNK 0x10000
+
+char *prog;
+
+void usage(){
+   char *msg =
+   " {-h | -c | -b <size>} ... [<file> ...]\n"
+   " Options:\n"
+   "   -h - usage (this text)\n"
+   "   -c - compress rather than decompress\n"
+   "   -b <size> - record size when compressing (default 512)\n"
+   "   <file> ... - files to copy to std. output (std. input if none or -)\n";
+   fprintf(stderr, "Usage: %s%s", prog, msg);
+   fflush(stderr);
+}
+
+void err(char *msg){
+   fprintf(stderr, "%s: %s\n", prog, msg); fflush(stderr);
+   exit(1);
+}
+
+void copy(char *fn, FILE *out){
+   static char buf[CHUNK];
+   struct msz *z;
+   ssize_t n;
+   int fd;
+
+   fd = strcmp(fn, "-") ? open(fn, O_RDONLY) : 0;
+   if (fd < 0 || NULL == (z = mszfd(fd))) {
+      fprintf(stderr, "%s: can't open %s, skipped\n", prog, fn);
+      return;
+   }
+   while ((n = mszread(z, buf, sizeof(buf))) > 0)
+      if (1 != fwrite(buf, n, 1, out)) err("write error");
+   mszclose(z);
+}
+
+int main(int argc, char *argv[]){
+   FILE *out = stdout;
+   int i, n = 0, cmp = 0, lrecl = 512;
+
+   prog = argv[0];
+
+   for(i=1; i<argc; i++) {
+      if (argv[i][0] == '-' && argv[i][1]) { /* Check for option */
+         if (i+1 < argc && 0 == strcmp(argv[i], "-b")) {
+	    char *p;
+	    lrecl = strtol(argv[++i], &p, 10);
+	    if (*p || lrecl < 128) err("bad -b value");
+         } else if (0 == strcmp(argv[i], "-c")) {
+	    cmp = 1;
+         } else if (0 == strcmp(argv[i], "-h")) {
+	    usage();
+	 } else {
+	    fprintf(stderr, "bad arg (ignored): %s\n", argv[i]);
+	 }
+      }
+   }
+   if (cmp && NULL == (out = mszout(stdout, lrecl)))
+      err("can't set up compressed output");
+   for(i=1; i<argc; i++) {
+      if (argv[i][0] == '-' && argv[i][1]) {
+         if (0 == strcmp(argv[i], "-b")) i++;
+	 continue;
+      }
+      copy(argv[i], out); n++;
+   }
+   if (n == 0) copy("-", out);
+   if (fclose(out)) err("write error");
+   return 0;
+}
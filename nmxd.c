@@ -0,0 +1,748 @@
+/* Serve data from Taurus v3 stores to local clients, keeping each store's
+   allocation table and packet index in memory between requests.
+
+   G. Helffrich/U. Bristol
+      18 Oct. 2026
+
+Usage:  nmxd {-h | -v | -s <socket> | -S <name> | -N <name>} ... [<store> ...]
+        nmxd -c [-s <socket>] [-o <file>] <request> ...
+
+Command line parameters:
+   -h - usage (this text)
+   -v - verbose output:  log each request on the standard error output
+   -s <socket> - Unix socket to serve requests on, or (with -c) to send
+      them to (default /tmp/nmxd.socket)
+   -S <name> - station name for the records of the <store>s that follow
+      (default:  made from the Taurus serial number, as tv3mseed does)
+   -N <name> - network ID for the records of the <store>s that follow
+      (default YY)
+   <store> ... - stores to index at the start.  Each should be the first
+      file in the group describing a store, a name that includes the
+      suffix "001.store"; the rest of the store's file names are derived
+      from it.
+   -c - client:  send the request given by the rest of the arguments to
+      the daemon and write the answer on the standard output (or the -o
+      file).  Messages from the daemon go to the standard error output, and
+      the exit status is 1 if the request failed.
+
+Requests:
+   store <file> [<station> [<network>]] - index the store (or index it
+      again) under its serial number <sn>, e.g. 0665 (or 665) for
+      taurus_0665_001.store; the station name and network ID are used in
+      its MSEED records.
+   data <sn> <chan> <time> - MSEED records (512 bytes) of the channel from
+      store <sn> with data in the time span, in time order and numbered
+      from 1.  <chan> is Z, N or E, a channel code (BHZ, HH1, ...) or a
+      packet band number.
+   soh <sn> <time> - SOH packets in the time span as CSV lines, as
+      tv3mseed -fmt csv:  time,lat,lon,temp,mass1,mass2,mass3,supply
+   pos <sn> <time> - GPS position in each SOH packet in the time span:
+      <yyyy/mm/dd> <hh:mm:ss.fff> <lat> <lon>
+   list - a line for each store:  serial number, station, network, file
+      name, packets indexed, and the time of the first and last packet
+   quit - stop the daemon
+
+   <time> is given in the form the Apollo extraction scripts use, as
+      <yyyy> <mm> [<dd>]
+   for a whole month or day, or as a start and end time
+      yyyy/mm/dd[Thh:mm[:ss]] yyyy/mm/dd[Thh:mm[:ss]]
+
+   e.g.
+      nmxd /field/BABY/taurus_0665_001.store &
+      nmxd -c data 0665 Z 2015 6 30 > BABY150630.BHZ
+      nmxd -c soh 0665 2015 6 | awk -F, 'NR>1 {print $1, $5}'
+
+   The daemon opens the stores read-only, so needs no write permission on
+   them (unlike Apollo).  Each store is indexed by one pass through it,
+   packet by packet; requests are then answered from the in-memory index,
+   reading only the packets needed.  If a store's files have changed since
+   it was indexed (a store still being written, or mirrored from a
+   station), it is indexed again before answering.  Requests are served one
+   at a time.  Damaged packets end the indexing of their cluster, with a
+   message, but not the daemon.
+*/
+
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "msrec.h"
+
+#define HDRSIZ 36
+#define PKTMIN 40                  /* Plausible packet sizes */
+#define PKTMAX 0x10000
+#define SOCKET "/tmp/nmxd.socket"
+#define MAXFILE 999                /* Store files in a group */
+#define DAY 86400000000000ll
+
+char *prog;
+
+short verb = 0;
+
+/* Packet index entry */
+struct pkt {
+   int64_t t0, t1;                 /* Time of first sample, past last (ns) */
+   off_t off;                      /* Offset in its store file */
+   int siz;                        /* Packet size */
+   unsigned char band;
+   short fno;                      /* Store file number (1 = 001.store) */
+};
+
+/* An indexed store */
+struct store {
+   char *fn;                       /* First file of group */
+   char sn[5];                     /* Serial number */
+   char sta[6], net[3];            /* Station, network (blank: default) */
+   int nfile;
+   int *fd;                        /* Store files, opened read-only */
+   struct stat *sb;                /* Their state when indexed */
+   struct pkt *p;                  /* Packets, by band then time */
+   size_t np;
+   int64_t maxdt[256];             /* Longest packet time span by band */
+   char chid[256][4];              /* Channel code of each band */
+} *stores = NULL;
+size_t nstore = 0, mstore = 0;
+
+/* SOH field datatypes (blockette 1000 codes) and the fields known, as
+   tv3mseed */
+enum soh_type {HW = 1, FL = 4};
+struct sohf {
+   short type, off;
+   enum soh_type dt;
+   char *name;
+} sohflds[] = {
+   {0x0127,  7, FL, "temp"},       /* Environmental */
+   {0x0192,  9, FL, "mass1"},      /* Sensor SOH */
+   {0x0192, 18, FL, "mass2"},
+   {0x0192, 27, FL, "mass3"},
+   {0x012b, 19, HW, "supply"},     /* Power */
+};
+#define N_SOHFLD (sizeof(sohflds)/sizeof(struct sohf))
+
+void usage(){
+   char *msg =
+   " {-h | -v | -s <socket> | -S <name> | -N <name>} ... [<store> ...]\n"
+   "   or:  nmxd -c [-s <socket>] [-o <file>] <request> ...\n"
+   " Options:\n"
+   "   -h - usage (this text)\n"
+   "   -v - verbose output (log requests)\n"
+   "   -s <socket> - socket to serve on or send to (default " SOCKET ")\n"
+   "   -S <name> - station name for the <store>s that follow\n"
+   "   -N <name> - network ID for the <store>s that follow\n"
+   "   -c - client:  send request, write answer on standard output\n"
+   "   -o <file> - client:  write answer to <file>\n"
+   " Requests:\n"
+   "   store <file> [<station> [<network>]] - index store\n"
+   "   data <sn> {Z|N|E|<chan>|<band>} <time> - MSEED records of channel\n"
+   "   soh <sn> <time> - SOH packets as CSV\n"
+   "   pos <sn> <time> - GPS positions\n"
+   "   list - stores indexed\n"
+   "   quit - stop daemon\n"
+   " <time> is <yyyy> <mm> [<dd>] or yyyy/mm/dd[Thh:mm[:ss]] (twice)\n";
+   fprintf(stderr, "Usage: %s%s", prog, msg);
+   fflush(stderr);
+}
+
+void err(char *msg){
+   fprintf(stderr, "%s: %s\n", prog, msg); fflush(stderr);
+   exit(1);
+}
+
+void *grow(void *p, size_t *max, size_t need, size_t siz){
+   if (need <= *max) return p;
+   *max = need > 2*(*max) ? need : 2*(*max);
+   p = realloc(p, *max * siz);
+   if (p == NULL) err("out of memory");
+   return p;
+}
+
+int hw(unsigned char *p){
+   return (p[0] << 8) | p[1];
+}
+
+int fw(unsigned char *p){
+   return (p[0] << 24) | (p[1] << 16) | (p[2] <<  8) | p[3];
+}
+
+uint64_t dw(unsigned char *p){
+#define gp(n)((uint64_t)p[n])
+   return (gp(0)<< 56) | (gp(1)<< 48) | (gp(2)<< 40) | (gp(3)<< 32)
+        | (gp(4)<< 24) | (gp(5)<< 16) | (gp(6)<<  8) | gp(7);
+}
+
+void phw(unsigned char *p, int v){
+   p[1] = v & 0xff; p[0] = (v >> 8) & 0xff;
+}
+
+/* Sample rate from SEED rate factor and multiplier */
+
+double srate(int srf, int srm){
+   return (srf>0 && srm>0) ?  srf*srm :
+          (srf>0 && srm<0) ? -(double)srf/srm :
+          (srf<0 && srm>0) ? -(double)srm/srf : 1/((double)srf*srm);
+}
+
+/* Packet size, from its header */
+
+size_t pktsiz(unsigned char buf[]){
+   size_t siz = hw(buf+2) & 0x1fff;  /* Mask high bit flags */
+   if ((buf[2]>>5 & 0x03) == 3) siz |= hw(buf+29+8) << 13;
+   if ((buf[2]>>5 & 0x03) == 2) siz |= hw(buf+29+1) << 13;
+   return siz;
+}
+
+/* Offset of a packet's payload (data or SOH items), past any extension */
+
+int pktpay(unsigned char buf[]){
+   int off = (buf[2]>>5) == 3 ? 29+8+2 : (buf[2]>>5) == 2 ? 29+8 : 30;
+   if (buf[2] & 0x80) off += 1+buf[off];
+   return off;
+}
+
+/* Name of store file number fno of the group whose first file is fn */
+
+char *stfn(char *fn, int fno){
+   static char *name = NULL;
+   static size_t mname = 0;
+   char *p;
+
+   name = grow(name, &mname, strlen(fn)+1, 1);
+   strcpy(name, fn);
+   if (fno > 1 && (p = strstr(name, "001.store")))
+      sprintf(p, "%03d.store", fno);
+   return name;
+}
+
+int cmppkt(const void *a, const void *b){
+   const struct pkt *x = a, *y = b;
+   if (x->band != y->band) return x->band - y->band;
+   if (x->t0 != y->t0) return (x->t0 > y->t0) - (x->t0 < y->t0);
+   if (x->fno != y->fno) return x->fno - y->fno;
+   return (x->off > y->off) - (x->off < y->off);
+}
+
+/* Close a store's files and free its index */
+
+void stfree(struct store *s){
+   int i;
+
+   for(i=0; i<s->nfile; i++) close(s->fd[i]);
+   free(s->fd); free(s->sb); free(s->p);
+   s->fd = NULL; s->sb = NULL; s->p = NULL;
+   s->nfile = 0; s->np = 0;
+}
+
+/* Name a data band on first sight:  BHZ, BHN and BHE for the usual bands,
+   otherwise from the sample rate, with the first number 1-9 that no other
+   band has, as tv3mseed does.  Returns 0 if no number is left. */
+
+int chname(struct store *s, int b, double sr){
+   int i;
+
+   if (b == 65 || b == 67 || b == 69) {
+      sprintf(s->chid[b], "BH%c", "ZNE"[(b-65)>>1]);
+      return 1;
+   }
+   s->chid[b][0] = sr >= 80 ? 'H' : sr >= 10 ? 'B' : sr >= 1 ? 'L' :
+      sr >= 0.1 ? 'V' : 'U';
+   s->chid[b][1] = 'H'; s->chid[b][3] = 0;
+   for(s->chid[b][2]='1'; s->chid[b][2]<='9'; s->chid[b][2]++) {
+      for(i=0; i<256 && (i == b || strcmp(s->chid[i], s->chid[b])); i++);
+      if (i >= 256) return 1;
+   }
+   s->chid[b][0] = 0;
+   return 0;
+}
+
+/* Index a store:  read its allocation table and every packet header in
+   its clusters.  Returns NULL if all went well, or else what went wrong. */
+
+char *stidx(struct store *s){
+   static unsigned char buf[PKTMAX];
+   unsigned char *tbl;
+   size_t i, ntbl, tsiz, mp = 0;
+   off_t scum = 0, off, fsiz;
+   int fno = 1, b;
+   FILE *fd;
+
+   stfree(s);
+   s->fd = malloc(MAXFILE*sizeof(int));
+   s->sb = malloc(MAXFILE*sizeof(struct stat));
+   if (s->fd == NULL || s->sb == NULL) err("out of memory");
+   memset(s->maxdt, 0, sizeof(s->maxdt));
+
+   /* Open the store's files; the allocation table is in the first */
+   for(s->nfile=0; s->nfile<MAXFILE; s->nfile++) {
+      int f = open(stfn(s->fn, s->nfile+1), O_RDONLY);
+      if (f < 0) break;
+      s->fd[s->nfile] = f;
+      if (fstat(f, s->sb+s->nfile)) err("can't stat store file");
+   }
+   if (s->nfile == 0) return "can't open store";
+   if (pread(s->fd[0], buf, 48, 0) != 48 || strncmp((char*)buf, "NMXV", 4))
+      return "not a NMX store";
+   if (strncmp((char*)buf+32, "VOLFALOC", 8)) return "missing allocation table";
+   ntbl = fw(buf+32+8); tsiz = fw(buf+32+12);
+   if (tsiz < 48 || ntbl > (tsiz-48)/16) return "bad allocation table";
+   tbl = malloc(tsiz);
+   if (tbl == NULL) err("out of memory");
+   if (pread(s->fd[0], tbl, tsiz-48, 48) != tsiz-48) {
+      free(tbl);
+      return "short allocation table";
+   }
+
+   /* Walk the table.  Offsets run on from one store file to the next;
+      each file starts with a volume header. */
+   fd = NULL;
+   for(i=0; i<ntbl; i++) {
+      off = (off_t)dw(tbl+i*16+4) - scum;
+      while (fno <= s->nfile &&
+             off >= (fsiz = s->sb[fno-1].st_size - HDRSIZ)) {
+         scum += fsiz; off -= fsiz; fno += 1;
+	 if (fd) {fclose(fd); fd = NULL;}
+      }
+      if (fno > s->nfile) break;
+      if (fd == NULL) {
+         fd = fdopen(dup(s->fd[fno-1]), "r");
+	 if (fd == NULL) err("can't read store file");
+      }
+      if (fseeko(fd, off, SEEK_SET) || 1 != fread(buf, 68, 1, fd)) continue;
+      if (strncmp((char*)buf+36, "CLUS", 4)) continue;
+      off += 68;
+      for(;;) {
+	 struct pkt *p;
+	 size_t siz;
+	 int pay;
+         if (1 != fread(buf, 40, 1, fd) || 0 == strncmp((char*)buf,
+	    "ENDODATA", 8)) break;
+	 siz = pktsiz(buf);
+	 if (buf[0] != 'n' || buf[1] != 'p' || siz < PKTMIN || siz > PKTMAX
+	  || (siz > 40 && 1 != fread(buf+40, siz-40, 1, fd))) {
+	    fprintf(stderr, "%s: %s at offset %llx, bad packet; "
+	       "rest of cluster skipped\n", prog, stfn(s->fn, fno),
+	       (long long)off);
+	    break;
+	 }
+	 b = buf[27]; pay = pktpay(buf);
+	 if (b != 71 && (pay+8 > siz || buf[pay] != 0x01 || buf[pay+1] != 0xc8)
+	  && b != 65 && b != 67 && b != 69) b = -1;
+	 if (b >= 0) {
+	    s->p = grow(s->p, &mp, s->np+1, sizeof(struct pkt));
+	    p = s->p + s->np++;
+	    p->t0 = p->t1 = dw(buf+8);
+	    p->off = off; p->siz = siz; p->band = b; p->fno = fno;
+	    if (b != 71 && buf[pay+4] && buf[pay+5]) {
+	       p->t1 += 1e9*hw(buf+pay+6)/srate((signed char)buf[pay+4],
+	          (signed char)buf[pay+5]);
+	       if (p->t1 - p->t0 > s->maxdt[b]) s->maxdt[b] = p->t1 - p->t0;
+	       if (s->chid[b][0] == 0 && !chname(s, b,
+	          srate((signed char)buf[pay+4], (signed char)buf[pay+5]))) {
+		  if (fd) fclose(fd);
+		  free(tbl);
+		  return "more data bands than channel codes";
+	       }
+	    }
+	 }
+	 off += siz + ((0x03 & siz) ? 4-(0x03&siz) : 0);
+	 if (fseeko(fd, off, SEEK_SET)) break;
+      }
+   }
+   if (fd) fclose(fd);
+   free(tbl);
+   qsort(s->p, s->np, sizeof(struct pkt), cmppkt);
+   if (verb) fprintf(stderr, "%s: %s indexed, %zu packets\n", prog, s->fn,
+      s->np);
+   return NULL;
+}
+
+/* Find store by serial number, indexing it again if its files changed */
+
+struct store *stget(char *sn, char **why){
+   struct stat sb;
+   size_t i;
+   int j;
+
+   for(i=0; i<nstore && atoi(stores[i].sn) != atoi(sn); i++);
+   if (i >= nstore) {
+      *why = "no such store";
+      return NULL;
+   }
+   for(j=0; j<=stores[i].nfile; j++) {
+      int ok = 0 == stat(stfn(stores[i].fn, j+1), &sb);
+      if (j == stores[i].nfile ? ok : !ok || sb.st_size != stores[i].sb[j].st_size
+       || sb.st_mtime != stores[i].sb[j].st_mtime) break;
+   }
+   if (j <= stores[i].nfile && (*why = stidx(stores+i))) return NULL;
+   return stores+i;
+}
+
+/* Add (or replace) a store */
+
+char *stadd(char *fn, char *sta, char *net){
+   char *p = strstr(fn, "001.store"), *why;
+   struct store *s;
+   size_t i;
+
+   if (p == NULL || p-fn < 5 || p[-1] != '_')
+      return "unusual store name (looking for _001.store suffix)";
+   for(i=0; i<nstore && strncmp(stores[i].sn, p-5, 4); i++);
+   if (i >= nstore) {
+      stores = grow(stores, &mstore, nstore+1, sizeof(struct store));
+      memset(stores+nstore++, 0, sizeof(struct store));
+   }
+   s = stores+i;
+   free(s->fn);
+   s->fn = strdup(fn);
+   if (s->fn == NULL) err("out of memory");
+   memcpy(s->sn, p-5, 4); s->sn[4] = 0;
+   memset(s->chid, 0, sizeof(s->chid));
+   snprintf(s->sta, sizeof(s->sta), "%s", sta ? sta : "");
+   snprintf(s->net, sizeof(s->net), "%s", net ? net : "");
+   if ((why = stidx(s))) return why;
+   return NULL;
+}
+
+/* First packet of band with data at or after time t */
+
+size_t stfind(struct store *s, int band, int64_t t){
+   size_t lo = 0, hi = s->np, mid;
+   int64_t t0 = t - s->maxdt[band];
+
+   while (lo < hi) {
+      mid = (lo+hi)/2;
+      if (s->p[mid].band < band
+       || (s->p[mid].band == band && s->p[mid].t0 < t0))
+         lo = mid+1;
+      else
+         hi = mid;
+   }
+   return lo;
+}
+
+/* Read an indexed packet */
+
+int stread(struct store *s, struct pkt *p, unsigned char buf[]){
+   return pread(s->fd[p->fno-1], buf, p->siz, p->off) == p->siz
+       && buf[0] == 'n' && buf[1] == 'p';
+}
+
+/* Write the MSEED records of a band's packets with data in [t0, t1), as
+   tv3mseed would make them */
+
+void rqdata(FILE *out, struct store *s, int band, int64_t t0, int64_t t1){
+   static unsigned char buf[PKTMAX];
+   unsigned char rec[512];
+   char id[16];
+   struct pkt *p;
+   size_t i;
+   int seq = 1, j, k, pay, len, iid;
+
+   fprintf(out, "ok\n");
+   for(i=stfind(s, band, t0); i<s->np && s->p[i].band == band
+       && s->p[i].t0 < t1; i++) {
+      time_t tt;
+      struct tm tm;
+      p = s->p+i;
+      if (p->t1 > p->t0 ? p->t1 <= t0 : p->t0 < t0) continue;
+      if (!stread(s, p, buf)) {
+         fprintf(stderr, "%s: %s, can't read packet at offset %llx\n",
+	    prog, stfn(s->fn, p->fno), (long long)p->off);
+	 continue;
+      }
+      pay = pktpay(buf);
+
+      /* Fixed header and blockette 1000 */
+      memset(rec, 0, sizeof(rec));
+      for(j=5, k=seq++%1000000; j>=0; j--, k/=10) rec[j] = '0' + k%10;
+      rec[6] = 'D'; rec[7] = ' ';
+      iid = hw(buf+25);
+      if (s->sta[0])
+         sprintf(id, "%-5s", s->sta);
+      else
+         sprintf(id, "%c%04d", "0123456789ABCDEF"[iid/10000], iid%10000);
+      memcpy(rec+8, id, 5);
+      rec[13] = ' '; rec[14] = ' ';
+      memcpy(rec+15, s->chid[band], 3);
+      rec[18] = s->net[0] ? s->net[0] : 'Y';
+      rec[19] = s->net[1] ? s->net[1] : 'Y';
+      tt = p->t0/1000000000ll;
+      gmtime_r(&tt, &tm);
+      phw(rec+20, tm.tm_year+1900);
+      phw(rec+22, tm.tm_yday+1);
+      rec[24] = tm.tm_hour; rec[25] = tm.tm_min; rec[26] = tm.tm_sec;
+      phw(rec+28, (p->t0%1000000000ll)/100000);
+      phw(rec+30, hw(buf+pay+6));
+      phw(rec+32, buf[pay+4]);
+      phw(rec+34, buf[pay+5]);
+      rec[39] = 1;
+      phw(rec+44, 64);
+      phw(rec+46, 48);
+      phw(rec+48, 1000);
+      rec[48+4] = 10; rec[48+5] = 1; rec[48+6] = 9;
+
+      /* Steim frames from the packet */
+      len = p->siz - pay - 8;
+      if (len > 512-64) {
+         fprintf(stderr, "%s: %s data block %d > 512 (len is %d); "
+	    "truncated\n", prog, s->chid[band], seq-1, len);
+         len = 512-64;
+      }
+      if (len > 0) memcpy(rec+64, buf+pay+8, len);
+      if (1 != fwrite(rec, sizeof(rec), 1, out)) return;
+   }
+}
+
+/* Decode the SOH items in a packet's payload (as tv3mseed) */
+
+int sohdec(int buflen, unsigned char buf[], int val[]){
+   size_t off = 0;
+   int i, have = 0;
+
+   while (off + 4 <= buflen) {
+      short siz = hw(buf+off) & 0x1fff, type = hw(buf+off+2);
+      if (siz <= 0) break;
+      for(i=0; i<N_SOHFLD; i++) {
+	 struct sohf *f = sohflds+i;
+         if (f->type != type || off + f->off + (f->dt == HW ? 2 : 4) > buflen)
+	    continue;
+	 val[i] = f->dt == HW ? (short)hw(buf+off+f->off) : fw(buf+off+f->off);
+	 have |= 1<<i;
+      }
+      off += siz;
+   }
+   return have;
+}
+
+/* Write SOH packets in [t0, t1) as CSV lines (pos:  just positions) */
+
+void rqsoh(FILE *out, struct store *s, int pos, int64_t t0, int64_t t1){
+   static unsigned char buf[PKTMAX];
+   struct pkt *p;
+   char tim[32];
+   int val[N_SOHFLD], have, pay;
+   size_t i, j;
+
+   fprintf(out, "ok\n");
+   if (!pos) {
+      fprintf(out, "time,lat,lon");
+      for(j=0; j<N_SOHFLD; j++) fprintf(out, ",%s", sohflds[j].name);
+      fprintf(out, "\n");
+   }
+   for(i=stfind(s, 71, t0); i<s->np && s->p[i].band == 71
+       && s->p[i].t0 < t1; i++) {
+      p = s->p+i;
+      if (p->t0 < t0 || !stread(s, p, buf)) continue;
+      pay = pktpay(buf);
+      msfmt(p->t0, tim); tim[23] = 0;
+      if (pos) {
+         fprintf(out, "%s %f %f\n", tim, 1e-6*fw(buf+16), 1e-6*fw(buf+20));
+	 continue;
+      }
+      tim[10] = ' ';
+      fprintf(out, "%s,%f,%f", tim, 1e-6*fw(buf+16), 1e-6*fw(buf+20));
+      have = sohdec(p->siz-pay, buf+pay, val);
+      for(j=0; j<N_SOHFLD; j++) {
+	 union { unsigned int fw; float fl; } u;
+         if (!(have & 1<<j))
+	    fprintf(out, ",");
+	 else if (sohflds[j].dt == HW)
+	    fprintf(out, ",%d", val[j]);
+	 else {
+	    u.fw = val[j]; fprintf(out, ",%f", u.fl);
+	 }
+      }
+      fprintf(out, "\n");
+   }
+}
+
+/* Time span of a request:  <yyyy> <mm> [<dd>] or two times.  Returns the
+   number of words used, or 0 if they make no sense. */
+
+int rqtime(int n, char *w[], int64_t *t0, int64_t *t1){
+   char str[32];
+   int yr, mo, dy;
+
+   if (n >= 2 && strchr(w[0], '/'))
+      return mstime(w[0], t0) || mstime(w[1], t1) || *t1 <= *t0 ? 0 : 2;
+   if (n < 2 || 1 != sscanf(w[0], "%d", &yr) || 1 != sscanf(w[1], "%d", &mo)
+    || mo < 1 || mo > 12) return 0;
+   if (n >= 3) {
+      if (1 != sscanf(w[2], "%d", &dy)) return 0;
+      sprintf(str, "%04d/%02d/%02d", yr, mo, dy);
+      if (mstime(str, t0)) return 0;
+      *t1 = *t0 + DAY;
+      return 3;
+   }
+   sprintf(str, "%04d/%02d/01", yr, mo);
+   if (mstime(str, t0)) return 0;
+   sprintf(str, "%04d/%02d/01", mo == 12 ? yr+1 : yr, mo == 12 ? 1 : mo+1);
+   (void)mstime(str, t1);
+   return 2;
+}
+
+/* Answer one request; returns 1 if the daemon is to stop */
+
+int serve(int c){
+   FILE *in = fdopen(c, "r"), *out = fdopen(dup(c), "w");
+   char line[4096], *w[16], *why = NULL;
+   struct store *s;
+   int64_t t0, t1;
+   int n = 0, band = -1, stop = 0;
+   size_t i;
+
+   if (in == NULL || out == NULL) err("can't set up connection");
+   if (fgets(line, sizeof(line), in) == NULL) goto done;
+   for(w[n] = strtok(line, " \t\r\n"); w[n] && n < 15;
+       w[++n] = strtok(NULL, " \t\r\n"));
+   if (n == 0) goto done;
+   if (verb) {
+      fprintf(stderr, "%s:", prog);
+      for(i=0; i<n; i++) fprintf(stderr, " %s", w[i]);
+      fprintf(stderr, "\n");
+   }
+   if (0 == strcmp(w[0], "store") && n >= 2) {
+      if ((why = stadd(w[1], n > 2 ? w[2] : NULL, n > 3 ? w[3] : NULL)))
+         goto done;
+      for(i=0; i<nstore && strcmp(stores[i].fn, w[1]); i++);
+      fprintf(out, "ok\nstore %s %zu packets\n", stores[i].sn, stores[i].np);
+   } else if (0 == strcmp(w[0], "list")) {
+      fprintf(out, "ok\n");
+      for(i=0; i<nstore; i++) {
+         char a[32] = "-", b[32] = "-";
+	 int64_t tmin = INT64_MAX, tmax = INT64_MIN;
+	 size_t j;
+	 for(j=0; j<stores[i].np; j++) {
+	    if (stores[i].p[j].t0 < tmin) tmin = stores[i].p[j].t0;
+	    if (stores[i].p[j].t0 > tmax) tmax = stores[i].p[j].t0;
+	 }
+	 if (stores[i].np) {msfmt(tmin, a); msfmt(tmax, b); a[10] = b[10] = 'T';}
+         fprintf(out, "%s %s %s %s %zu %s %s\n", stores[i].sn,
+	    stores[i].sta[0] ? stores[i].sta : "-",
+	    stores[i].net[0] ? stores[i].net : "-",
+	    stores[i].fn, stores[i].np, a, b);
+      }
+   } else if (0 == strcmp(w[0], "quit")) {
+      fprintf(out, "ok\n");
+      stop = 1;
+   } else if (0 == strcmp(w[0], "data") && n >= 5) {
+      if ((s = stget(w[1], &why)) == NULL) goto done;
+      if (0 == strcmp(w[2], "Z") || 0 == strcmp(w[2], "N")
+       || 0 == strcmp(w[2], "E"))
+         band = 65 + 2*(strchr("ZNE", w[2][0]) - "ZNE");
+      else if (1 != sscanf(w[2], "%d", &band))
+         for(band=255; band>=0 && strcmp(s->chid[band], w[2]); band--);
+      if (band < 0 || band > 255 || band == 71) {why = "bad channel"; goto done;}
+      if (0 == rqtime(n-3, w+3, &t0, &t1)) {why = "bad time"; goto done;}
+      rqdata(out, s, band, t0, t1);
+   } else if ((0 == strcmp(w[0], "soh") || 0 == strcmp(w[0], "pos"))
+           && n >= 4) {
+      if ((s = stget(w[1], &why)) == NULL) goto done;
+      if (0 == rqtime(n-2, w+2, &t0, &t1)) {why = "bad time"; goto done;}
+      rqsoh(out, s, w[0][0] == 'p', t0, t1);
+   } else
+      why = "bad request";
+done:
+   if (why) fprintf(out, "error %s\n", why);
+   fclose(out); fclose(in);
+   return stop;
+}
+
+/* Client:  send request, copy the answer out */
+
+int client(char *sock, char *ofn, int n, char *w[]){
+   struct sockaddr_un sa;
+   char line[4096], req[4096];
+   FILE *in, *out = stdout;
+   size_t i, k = 0;
+   int c;
+
+   for(i=0; i<n; i++)
+      k += snprintf(req+k, k < sizeof(req) ? sizeof(req)-k : 0, "%s%s",
+         w[i], i+1 < n ? " " : "\n");
+   if (n == 0 || k >= sizeof(req)) err("bad request");
+   c = socket(AF_UNIX, SOCK_STREAM, 0);
+   memset(&sa, 0, sizeof(sa));
+   sa.sun_family = AF_UNIX;
+   snprintf(sa.sun_path, sizeof(sa.sun_path), "%s", sock);
+   if (c < 0 || connect(c, (struct sockaddr*)&sa, sizeof(sa)))
+      err("can't connect to daemon -- nmxd running?");
+   if (write(c, req, k) != k) err("can't send request");
+   in = fdopen(c, "r");
+   if (in == NULL || fgets(line, sizeof(line), in) == NULL)
+      err("no answer from daemon");
+   if (strncmp(line, "ok\n", 3)) {
+      fprintf(stderr, "%s: %s", prog,
+         strncmp(line, "error ", 6) ? line : line+6);
+      return 1;
+   }
+   if (ofn && (out = fopen(ofn, "w")) == NULL) err("can't open -o file");
+   while ((k = fread(req, 1, sizeof(req), in)) > 0)
+      if (k != fwrite(req, 1, k, out)) err("error writing answer");
+   if (fclose(out)) err("error writing answer");
+   fclose(in);
+   return 0;
+}
+
+int main(int argc, char *argv[]){
+   struct sockaddr_un sa;
+   char *sock = SOCKET, *ofn = NULL, *sta = NULL, *net = NULL, *why;
+   int i, c, lfd, clnt = 0;
+
+   prog = argv[0];
+
+   for(i=1; i<argc; i++) {
+      if (argv[i][0] == '-') { /* Check for option */
+         if (i+1 < argc && 0 == strcmp(argv[i], "-s")) {
+	    sock = argv[++i];
+         } else if (i+1 < argc && 0 == strcmp(argv[i], "-o")) {
+	    ofn = argv[++i];
+         } else if (i+1 < argc && 0 == strcmp(argv[i], "-S")) {
+	    sta = argv[++i];
+	    if (strlen(sta) > 5) err("-S name too long");
+         } else if (i+1 < argc && 0 == strcmp(argv[i], "-N")) {
+	    net = argv[++i];
+	    if (strlen(net) > 2) err("-N name too long");
+         } else if (0 == strcmp(argv[i], "-c")) {
+	    clnt = 1;
+         } else if (0 == strcmp(argv[i], "-v")) {
+	    verb = 1;
+         } else if (0 == strcmp(argv[i], "-h")) {
+	    usage(); exit(0);
+	 } else
+	    fprintf(stderr, "bad arg (ignored): %s\n", argv[i]);
+      } else if (clnt) {
+         return client(sock, ofn, argc-i, argv+i);
+      } else if ((why = stadd(argv[i], sta, net))) {
+         fprintf(stderr, "%s: %s: %s\n", prog, argv[i], why);
+	 exit(1);
+      }
+   }
+   if (clnt) err("no request given");
+
+   /* Serve requests on the socket until told to quit */
+   signal(SIGPIPE, SIG_IGN);
+   lfd = socket(AF_UNIX, SOCK_STREAM, 0);
+   memset(&sa, 0, sizeof(sa));
+   sa.sun_family = AF_UNIX;
+   if (strlen(sock) >= sizeof(sa.sun_path)) err("socket name too long");
+   strcpy(sa.sun_path, sock);
+   (void)unlink(sock);
+   if (lfd < 0 || bind(lfd, (struct sockaddr*)&sa, sizeof(sa))
+    || listen(lfd, 8)) err("can't set up socket");
+   if (verb) fprintf(stderr, "%s: serving on %s\n", prog, sock);
+   for(;;) {
+      c = accept(lfd, NULL, NULL);
+      if (c < 0) continue;
+      if (serve(c)) break;
+   }
+   close(lfd);
+   (void)unlink(sock);
+   return 0;
+}
@@ -6,7 +6,8 @@ C
 C     As command line argument, give MSEED file name.  Output is start time.
 C     Otherwise, reads file names from std. input and processes each one.
 C     Options:
-C        -b - block size in bytes [default 512]
+C        -b - block size in bytes for records without a blockette 1000
+C           [default 512]; others have the size it gives, up to 64 KB
 C        -mv - write output as mv commands for renaming (as shell
 C           script input)
 C        -new - create entirely new name from station info in header.
@@ -14,21 +15,32 @@ C           Otherwise, the file name is searched for a string that
 C           contains YYMMDD000000 (year, month day) of the first datum
 C           and replaces the 000000 with the HHMMSS of the first sample.
 C        -noseq - ignore out-of-sequence block numbering.
+C        -rn - rename the files directly rather than writing mv commands.
+C           Use with a list of file names on std. input to rename a whole
+C           archive in one process, e.g.
+C              find /tmp/pool -type f | rnmseed -new -rn
+C           Files whose new name already exists are left alone.
+C        -n - with -rn, only list (as mv commands) what would be renamed.
+C     Files may be compressed (tv3mseed -c); records are read through the
+C     routines in msz.c, which handle either kind.
 C
 C     By George Helffrich, U. Bristol, June 1, 2007, Oct. 10, 2010
 C        updated 26 May 2014
+C        updated 18 Oct. 2026
       program rnmseed
-      parameter (mxbuf=8192, iucd=99)
+      parameter (mxbuf=65536)
       character posstr*16
       character cdname*256, fn*256, sname*32, posn*16
       character inbuf*(mxbuf)
-      integer lrecl
-      logical omv,onew,oseq
+      integer lrecl, lrdef
+      logical omv,onew,oseq,orn,odry,oex
 
       omv = .false.
       onew = .false.
       oseq = .true.
-      lrecl = 512
+      orn = .false.
+      odry = .false.
+      lrdef = 512
       n = 0
       iskip = 0
       do 5 i=1,iargc()
@@ -38,9 +50,9 @@ C        updated 26 May 2014
 	    if (posn .eq. '-b') then
 	       call getarg(i+1,posn)
 	       ios = -1
-	       if (posn .ne. ' ') read(posn,*,iostat=ios) lrecl
+	       if (posn .ne. ' ') read(posn,*,iostat=ios) lrdef
 	       if (ios .ne. 0) stop '**Bad -b value'
-	       if (lrecl .gt. mxbuf) stop '**-b value too large'
+	       if (lrdef .gt. mxbuf) stop '**-b value too large'
 	       iskip = i+1
 	    else if (posn .eq. '-mv') then
 	       omv = .true.
@@ -48,6 +60,10 @@ C        updated 26 May 2014
 	       onew = .true.
 	    else if (posn .eq. '-noseq') then
 	       oseq = .false.
+	    else if (posn .eq. '-rn') then
+	       orn = .true.
+	    else if (posn .eq. '-n') then
+	       odry = .true.
 	    else
 	       write(0,*) '**Bad option: ',posn(1:index(posn,' ')-1)
 	       stop
@@ -57,6 +73,7 @@ C        updated 26 May 2014
 	    n = n + 1
 	 endif
 5     continue
+      if (odry .and. .not.orn) stop '**-n only makes sense with -rn'
 
 1000  continue
          if (n .le. 0) then
@@ -64,15 +81,17 @@ C        updated 26 May 2014
 	    if (ios.ne.0) stop
 	 endif
 
-         open(iucd,file=cdname,
-     &      access='direct',
-     &      form='unformatted',
-     &      recl=lrecl,
-     &      iostat=ios)
-         if (ios .ne. 0) stop '**Bad file name, can''t open.'
+         call mszopn(cdname,iz,ios)
+         if (ios .ne. 0) then
+	    if (n .ne. 0) stop '**Bad file name, can''t open.'
+	    ix = index(cdname, ' ')
+	    write(0,*) '**Can''t open ',cdname(1:ix-1),', skipped.'
+	    go to 1000
+	 endif
 
 	 nprec = 1
-	 read(iucd, rec=nprec, err=9100) inbuf(1:lrecl)
+	 call mszrd(iz,nprec,lrdef,inbuf,lrecl,ios)
+	 if (ios .ne. 0) go to 9100
 	 read(inbuf(1:6),*,iostat=ios) nrec
 	 if (ios .ne. 0 .or. nrec .ne. nprec) then
 	    if (nprec .eq. 1) then
@@ -121,23 +140,38 @@ C    &      iyr,imo,idd,ihr,imn,isc,ith
 	 endif
 	 ix = index(cdname, ' ')
 	 iy = index(fn, ' ')
-	 if (omv .and. cdname(1:ix-1).ne.fn(1:iy-1)) then
+	 if (orn) then
+	    if (cdname(1:ix-1).eq.fn(1:iy-1)) go to 9000
+	    inquire(file=fn(1:iy-1), exist=oex)
+	    if (oex) then
+	       write(0,*) '**',fn(1:iy-1),' exists, ',cdname(1:ix-1),
+     &            ' not renamed.'
+	    else if (odry) then
+	       write(*,'(a,1x,a,1x,a)') 'mv',cdname(1:ix-1),fn(1:iy-1)
+	    else
+	       call rename(cdname(1:ix-1), fn(1:iy-1), ios)
+	       if (ios .ne. 0) write(0,*) '**Rename of ',
+     &            cdname(1:ix-1),' failed.'
+	    endif
+	 else if (omv .and. cdname(1:ix-1).ne.fn(1:iy-1)) then
 	    write(*,'(a,1x,a,1x,a)') 'mv',cdname(1:ix-1),fn(1:iy-1)
 	 else if (.not.omv) then
 	    write(*,'(a,1x,a)') cdname(1:ix-1),fn(1:iy-1)
 	 endif
 9000     continue
-         close(iucd)
+         call mszcls(iz)
          if (n .ne. 0) stop
       go to 1000
 9100  continue
-      write(0,*) '**Read error on input file.'
+      ix = index(cdname, ' ')
+      write(0,*) '**Read error on input file ',cdname(1:ix-1),'.'
+      if (n .eq. 0) go to 9000
       end
 
       subroutine tmdec(btime,iyr,ijd,ihr,imn,isc,ith)
       character btime*10
 
-      integer ihalf*2
+      integer*2 ihalf
       character chalf*2
       equivalence (ihalf, chalf)
 
@@ -0,0 +1,485 @@
+/* Write MSEED records into an SDS (SeisComP data structure) archive:
+
+      <root>/YEAR/NET/STA/CHAN.D/NET.STA.LOC.CHAN.D.YEAR.DAY
+
+   one file for each stream and day (DAY is the day of the year, 001-366),
+   made along with the directories above it as needed.  A record goes into
+   the file of the day it starts in; a Steim-1 record holding data from both
+   sides of a midnight is split there, its samples decoded and compressed
+   again into a record for each day, so that every day file holds only its
+   own day's data.  The records in each file are numbered in turn, following
+   on from any already in it.
+
+   Appending to an archive:  a record is left out if its day file already
+   has one with the same start time and number of samples, so extracting
+   data that are already archived (the overlap when an incremental
+   extraction runs again, say) does not duplicate them.  Any other record is
+   added, even if it is earlier than what is there (another time window, a
+   store extracted out of time order, or late packets).  The start times in
+   a day file are read when it is first opened in a run and kept, with
+   those of the records added, until the archive is closed.
+
+   The day files in use are kept open, up to nfd of them; the one used least
+   recently is closed when another is needed.
+
+   G. Helffrich/U. Bristol
+      18 Oct. 2026
+*/
+
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/stat.h>
+#include "msrec.h"
+#include "sds.h"
+
+#define DAYNS 86400000000000ll     /* Nanoseconds in a day */
+#define SDSFT 8                    /* Fortran handle table size */
+#define ST1MAX (MSMAXREC/64*60)    /* Most samples in a Steim-1 record */
+
+struct dayf {                      /* Open day file */
+   char *path;
+   FILE *fd;
+   int seq;                        /* Last record number written */
+   int ix;                         /* Its entry in seen */
+   uint64_t use;                   /* When last used */
+};
+
+struct rkey {                      /* Record start time and sample count */
+   int64_t tns;
+   int nsamp;
+};
+
+struct seen {                      /* Day file opened before in this run */
+   char *path;
+   struct rkey *k;                 /* Records in it, in key order */
+   int nk, mk;
+};
+
+struct sds {
+   char *root;
+   struct dayf *f;
+   int nfd;
+   uint64_t clock;
+   struct seen *seen;
+   int nseen, mseen;
+   long ndup;                      /* Records left out as already there */
+};
+
+static int be16(unsigned char *p){
+   return (p[0] << 8) | p[1];
+}
+
+static int32_t be32(unsigned char *p){
+   return (int32_t)((uint32_t)p[0] << 24 | p[1] << 16 | p[2] << 8 | p[3]);
+}
+
+static void pb16(unsigned char *p, int v){
+   p[0] = v >> 8; p[1] = v;
+}
+
+static void pb32(unsigned char *p, uint32_t v){
+   p[0] = v >> 24; p[1] = v >> 16; p[2] = v >> 8; p[3] = v;
+}
+
+struct sds *sdsopen(char *root, int nfd){
+   struct sds *s = calloc(1, sizeof(struct sds));
+
+   if (s == NULL) return NULL;
+   s->root = strdup(root);
+   s->nfd = nfd > 0 ? nfd : SDSFD;
+   s->f = calloc(s->nfd, sizeof(struct dayf));
+   if (s->root == NULL || s->f == NULL) {
+      free(s->root); free(s->f); free(s);
+      return NULL;
+   }
+   return s;
+}
+
+/* Make the directories leading to a file */
+
+static int mkdirs(char *path){
+   char *p;
+
+   for(p = strchr(path+1, '/'); p; p = strchr(p+1, '/')) {
+      *p = 0;
+      if (mkdir(path, 0777) && errno != EEXIST) {
+         *p = '/';
+	 return -1;
+      }
+      *p = '/';
+   }
+   return 0;
+}
+
+static int dayclose(struct dayf *f){
+   int rc = fclose(f->fd) ? -1 : 0;
+   f->fd = NULL;
+   free(f->path); f->path = NULL;
+   return rc;
+}
+
+static int keycmp(struct rkey *a, struct rkey *b){
+   if (a->tns != b->tns) return a->tns < b->tns ? -1 : 1;
+   return a->nsamp - b->nsamp;
+}
+
+/* Look for key r among a day file's records; returns 1 if there, otherwise
+   0, with *ix where it would go */
+
+static int keyfind(struct seen *e, struct rkey *r, int *ix){
+   int lo = 0, hi = e->nk;
+
+   while (lo < hi) {
+      int mid = (lo+hi)/2, c = keycmp(e->k+mid, r);
+      if (c == 0) {*ix = mid; return 1;}
+      if (c < 0) lo = mid+1; else hi = mid;
+   }
+   *ix = lo;
+   return 0;
+}
+
+/* Add key r to a day file's records (if not there already) */
+
+static int keyadd(struct seen *e, struct rkey *r){
+   int ix;
+
+   if (keyfind(e, r, &ix)) return 0;
+   if (e->nk >= e->mk) {
+      struct rkey *n;
+      int m = e->mk ? 2*e->mk : 256;
+      n = realloc(e->k, m*sizeof(struct rkey));
+      if (n == NULL) return -1;
+      e->k = n; e->mk = m;
+   }
+   memmove(e->k+ix+1, e->k+ix, (e->nk-ix)*sizeof(struct rkey));
+   e->k[ix] = *r;
+   e->nk += 1;
+   return 0;
+}
+
+/* Read the start times of the records in a day file the first time it is
+   opened in this run, and the number of the last one */
+
+static int dayscan(struct dayf *f, struct seen *e){
+   static unsigned char rec[MSMAXREC];
+   struct mshdr lh;
+   struct rkey r;
+
+   if (fseeko(f->fd, 0, SEEK_SET)) return -1;
+   while (1 == fread(rec, 128, 1, f->fd) && 0 == msdec(rec, &lh)) {
+      int lrecl = lh.lrecl ? lh.lrecl : 512;
+      if (lrecl < 128 || lrecl > MSMAXREC ||
+          1 != fread(rec+128, lrecl-128, 1, f->fd)) break;
+      r.tns = lh.tns; r.nsamp = lh.nsamp;
+      if (keyadd(e, &r)) return -1;
+      f->seq = lh.seq > 0 ? lh.seq : 0;
+   }
+   return fseeko(f->fd, 0, SEEK_END) ? -1 : 0;
+}
+
+/* Day file for a record of stream h starting at time tns, opening it (and
+   closing the least recently used) if it isn't open */
+
+static struct dayf *dayfile(struct sds *s, struct mshdr *h, int64_t tns){
+   char *path;
+   struct dayf *f = NULL;
+   unsigned char hdr[128];
+   struct mshdr lh;
+   time_t t = tns/1000000000ll;
+   struct tm tm;
+   off_t siz;
+   int i;
+
+   gmtime_r(&t, &tm);
+   path = malloc(strlen(s->root) + 80);
+   if (path == NULL) return NULL;
+   sprintf(path, "%s/%04d/%s/%s/%s.D/%s.%s.%s.%s.D.%04d.%03d", s->root,
+      1900+tm.tm_year, h->net, h->sta, h->chn,
+      h->net, h->sta, h->loc, h->chn, 1900+tm.tm_year, 1+tm.tm_yday);
+   for(i=0; i<s->nfd; i++) {
+      if (s->f[i].path && 0 == strcmp(s->f[i].path, path)) {
+         free(path);
+	 s->f[i].use = ++s->clock;
+	 return s->f+i;
+      }
+      if (f == NULL || (f->path && (s->f[i].path == NULL || s->f[i].use < f->use)))
+         f = s->f+i;
+   }
+   if (f->path && dayclose(f)) {
+      free(path);
+      return NULL;
+   }
+
+   if (mkdirs(path) || NULL == (f->fd = fopen(path, "a+"))) {
+      free(path);
+      return NULL;
+   }
+   f->path = path;
+   f->use = ++s->clock;
+   f->seq = 0;
+
+   for(i=0; i<s->nseen && strcmp(s->seen[i].path, path); i++);
+   f->ix = i;
+   if (i < s->nseen) {
+      /* Number on from the last record in the file */
+      if (fseeko(f->fd, 0, SEEK_END)) return NULL;
+      siz = ftello(f->fd);
+      if (siz >= (off_t)sizeof(hdr)) {
+         int lrecl = 512;
+	 if (0 == fseeko(f->fd, 0, SEEK_SET) &&
+	     1 == fread(hdr, sizeof(hdr), 1, f->fd) &&
+	     0 == msdec(hdr, &lh) && lh.lrecl) lrecl = lh.lrecl;
+	 if (siz >= lrecl &&
+	     0 == fseeko(f->fd, siz - lrecl, SEEK_SET) &&
+	     1 == fread(hdr, sizeof(hdr), 1, f->fd) && 0 == msdec(hdr, &lh))
+	    f->seq = lh.seq > 0 ? lh.seq : 0;
+	 if (fseeko(f->fd, 0, SEEK_END)) return NULL;
+      }
+   } else {
+      if (s->nseen >= s->mseen) {
+         struct seen *n;
+	 s->mseen = s->mseen ? 2*s->mseen : 64;
+	 n = realloc(s->seen, s->mseen*sizeof(struct seen));
+	 if (n == NULL) return NULL;
+	 s->seen = n;
+      }
+      memset(s->seen+i, 0, sizeof(struct seen));
+      if ((s->seen[i].path = strdup(path)) == NULL) return NULL;
+      s->nseen += 1;
+      if (dayscan(f, s->seen+i)) return NULL;
+   }
+   return f;
+}
+
+/* Write a record to its day file, numbering it */
+
+static int dayput(struct sds *s, unsigned char *rec, int lrecl,
+   struct mshdr *h
+){
+   static unsigned char buf[MSMAXREC];
+   struct dayf *f = dayfile(s, h, h->tns);
+   struct rkey r;
+   int i, j;
+
+   if (f == NULL) return -1;
+   r.tns = h->tns; r.nsamp = h->nsamp;
+   if (keyfind(s->seen+f->ix, &r, &i)) {
+      s->ndup += 1;
+      return 0;
+   }
+   if (keyadd(s->seen+f->ix, &r)) return -1;
+   f->seq += 1;
+   memcpy(buf, rec, lrecl);
+   for(i=5, j=f->seq%1000000; i>=0; i--, j/=10) buf[i] = '0' + j%10;
+   return 1 == fwrite(buf, lrecl, 1, f->fd) ? 0 : -1;
+}
+
+/* Steim-1 data:  frames of 16 words, the first a nibble for each word
+   saying what it holds (0 nothing, 1 four byte differences, 2 two half-word
+   differences, 3 a word difference).  The first frame's second and third
+   words are the first and last sample values. */
+
+static int st1dec(unsigned char *d, int nfr, int n, int32_t *x, int32_t *d0){
+   int f, j, k = 0, m;
+   int32_t x0 = 0, xn = 0;
+
+   for(f=0; f<nfr && k<n; f++) {
+      unsigned char *w = d + 64*f;
+      uint32_t c = be32(w);
+      for(j=1; j<16; j++) {
+         unsigned char *p = w + 4*j;
+	 if (f == 0 && j <= 2) {
+	    if (j == 1) x0 = be32(p); else xn = be32(p);
+	    continue;
+	 }
+	 switch (c >> (30-2*j) & 3) {
+	 case 1:
+	    for(m=0; m<4 && k<n; m++) x[k++] = (signed char)p[m];
+	    break;
+	 case 2:
+	    for(m=0; m<2 && k<n; m++) x[k++] = (short)be16(p+2*m);
+	    break;
+	 case 3:
+	    if (k<n) x[k++] = be32(p);
+	    break;
+	 }
+      }
+   }
+   if (k < n) return -1;
+   *d0 = x[0];
+   x[0] = x0;
+   for(k=1; k<n; k++) x[k] += x[k-1];
+   return x[n-1] == xn ? 0 : -1;
+}
+
+/* Compress up to n samples x, following sample xp, into nfr frames at d;
+   returns the number compressed */
+
+static int st1enc(unsigned char *d, int nfr, int32_t *x, int n, int32_t xp){
+   int f, j, m, i = 0;
+
+   memset(d, 0, 64*nfr);
+   for(f=0; f<nfr && i<n; f++) {
+      unsigned char *w = d + 64*f;
+      uint32_t c = 0;
+      for(j = f ? 1 : 3; j<16 && i<n; j++) {
+         int32_t dd[4];
+	 unsigned char *p = w + 4*j;
+	 int k = n-i < 4 ? n-i : 4, fit8 = k == 4, fit16 = k >= 2;
+	 for(m=0; m<k; m++) {
+	    dd[m] = (int32_t)((uint32_t)x[i+m] - (uint32_t)(i+m ? x[i+m-1] : xp));
+	    if (dd[m] < -128 || dd[m] > 127) fit8 = 0;
+	    if (m < 2 && (dd[m] < -32768 || dd[m] > 32767)) fit16 = 0;
+	 }
+	 if (fit8) {
+	    for(m=0; m<4; m++) p[m] = dd[m];
+	    c |= 1u << (30-2*j); i += 4;
+	 } else if (fit16) {
+	    pb16(p, dd[0]); pb16(p+2, dd[1]);
+	    c |= 2u << (30-2*j); i += 2;
+	 } else {
+	    pb32(p, dd[0]);
+	    c |= 3u << (30-2*j); i += 1;
+	 }
+      }
+      pb32(w, c);
+   }
+   pb32(d+4, x[0]); pb32(d+8, x[i-1]);
+   return i;
+}
+
+/* Data encoding from blockette 1000, or -1 if none */
+
+static int encoding(unsigned char *rec){
+   int b, nb;
+
+   for(b=be16(rec+46), nb=0; b >= 48 && b+8 <= 128 && nb < rec[39];
+       b=be16(rec+b+2), nb++)
+      if (be16(rec+b) == 1000) return rec[b+4];
+   return -1;
+}
+
+/* Split a Steim-1 record at each midnight in it.  Returns -1 if the record
+   can't be split (not big-endian Steim-1, or its data don't decode). */
+
+static int split(struct sds *s, unsigned char *rec, int lrecl,
+   struct mshdr *h
+){
+   static int32_t x[ST1MAX];
+   static unsigned char out[MSMAXREC];
+   int doff = be16(rec+44), nfr, i = 0;
+   int32_t d0, xp;
+   struct mshdr p = *h;
+
+   if (h->swap || encoding(rec) != 10) return -1;
+   if (doff < 48 || doff >= lrecl || h->nsamp > ST1MAX) return -1;
+   nfr = (lrecl - doff)/64;
+   if (st1dec(rec+doff, nfr, h->nsamp, x, &d0)) return -1;
+   xp = x[0] - d0;
+   while (i < h->nsamp) {
+      int64_t t = h->tns + (int64_t)(i*1e9/h->rate + 0.5);
+      int64_t mid = (t/DAYNS + 1)*DAYNS;
+      double q = (mid - h->tns)*h->rate/1e9;
+      int m = (int)q, n;
+      if (m < q - 1e-6) m += 1;    /* Samples before midnight */
+      m -= i;
+      if (m < 1) m = 1;
+      if (m > h->nsamp - i) m = h->nsamp - i;
+      while (m > 0) {
+         memcpy(out, rec, doff);
+	 memset(out+doff, 0, lrecl-doff);
+	 n = st1enc(out+doff, nfr, x+i, m, xp);
+	 pb16(out+30, n);
+	 t = h->tns + (int64_t)(i*1e9/h->rate + 0.5);
+	 msput(out, h, t);
+	 p.tns = t; p.nsamp = n;
+	 if (dayput(s, out, lrecl, &p)) return -2;
+	 xp = x[i+n-1]; i += n; m -= n;
+      }
+   }
+   return 0;
+}
+
+/* Put a record of length lrecl into the archive.  Returns 0 if OK, -1 if
+   not a data record or it can't be written. */
+
+int sdsput(struct sds *s, unsigned char *rec, int lrecl){
+   struct mshdr h;
+
+   if (msdec(rec, &h)) return -1;
+   if (h.rate > 0 && h.nsamp > 1) {
+      int64_t tl = h.tns + (int64_t)((h.nsamp-1)*1e9/h.rate);
+      if (tl/DAYNS != h.tns/DAYNS) {
+         int rc = split(s, rec, lrecl, &h);
+	 if (rc != -1) return rc ? -1 : 0;
+      }
+   }
+   return dayput(s, rec, lrecl, &h);
+}
+
+/* Number of records left out because they were already in the archive */
+
+long sdsdup(struct sds *s){
+   return s->ndup;
+}
+
+int sdsflush(struct sds *s){
+   int i, rc = 0;
+
+   for(i=0; i<s->nfd; i++)
+      if (s->f[i].fd && (fflush(s->f[i].fd) || fsync(fileno(s->f[i].fd))))
+         rc = -1;
+   return rc;
+}
+
+int sdsclose(struct sds *s){
+   int i, rc = 0;
+
+   for(i=0; i<s->nfd; i++)
+      if (s->f[i].path && dayclose(s->f+i)) rc = -1;
+   for(i=0; i<s->nseen; i++) {
+      free(s->seen[i].path); free(s->seen[i].k);
+   }
+   free(s->seen); free(s->f); free(s->root); free(s);
+   return rc;
+}
+
+/* Fortran interface:
+
+      call sdsopn(root, ih, ios) - open SDS archive in directory root,
+         returning handle ih; ios nonzero if not possible.
+      call sdswr(ih, buf, lrecl, ios) - put record of length lrecl in buf
+         into the archive; ios nonzero if it can't be written.
+      call sdscls(ih, ios) - close archive; ios nonzero if an error.
+*/
+
+static struct sds *sftab[SDSFT];
+
+void sdsopn_(char *root, int *ih, int *ios, size_t lroot){
+   char name[1024];
+   int i;
+
+   *ios = 1;
+   while (lroot > 0 && root[lroot-1] == ' ') lroot--;
+   if (lroot >= sizeof(name)) return;
+   memcpy(name, root, lroot); name[lroot] = 0;
+   for(i=0; i<SDSFT && sftab[i]; i++);
+   if (i >= SDSFT) return;
+   sftab[i] = sdsopen(name, SDSFD);
+   if (sftab[i] == NULL) return;
+   *ih = i+1; *ios = 0;
+}
+
+void sdswr_(int *ih, char *buf, int *lrecl, int *ios, size_t lbuf){
+   *ios = sdsput(sftab[*ih-1], (unsigned char *)buf, *lrecl) ? 1 : 0;
+}
+
+void sdscls_(int *ih, int *ios){
+   *ios = sdsclose(sftab[*ih-1]) ? 1 : 0;
+   sftab[*ih-1] = NULL;
+}
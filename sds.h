@@ -0,0 +1,15 @@
+/* Declarations for sds.c, writing MSEED records into an SDS archive.
+
+   G. Helffrich/U. Bristol
+      18 Oct. 2026
+*/
+
+#define SDSFD 32                   /* Day files kept open */
+
+struct sds;
+
+struct sds *sdsopen(char *root, int nfd);
+int sdsput(struct sds *s, unsigned char *rec, int lrecl);
+long sdsdup(struct sds *s);
+int sdsflush(struct sds *s);
+int sdsclose(struct sds *s);
@@ -2,48 +2,60 @@ C     Program to scan a Nanometrics SEED file comprised of data blockettes
 C     and split out into separate mseed files based on stream identification.
 C
 C     As command line argument, give SEED file path name and mseed
-C     output stream prefix.
+C     output stream prefix.  A file name of - reads the standard input
+C     (e.g. a pipe from tv3mseed); use -i if it carries several
+C     interleaved streams, since each has its own sequence numbers.
+C     The file may be compressed (tv3mseed -c); records are read through
+C     the routines in msz.c, which handle either kind.  Each record's
+C     length is taken from its blockette 1000, so files of any record size
+C     (up to 64 KB), or a mixture, are split without giving -b.  Sequence
+C     numbers may wrap from 999999 to 000000.
 C     Options:  -s n[hd] - split blockettes into separate files at n hour or
 C                  day boundaries
-C               -b - block size in bytes [default 512]
+C               -b - block size in bytes for records without a blockette
+C                  1000 [default 512]
 C               -d xxx - put data into directory xxx [default .]
 C               -S nnnn - change station name to nnnn
 C               -N XX - change network code to XX
 C               -L XX - only select data with LOCID XX
 C               -i - ignore sequence checking
+C               -sds - put data into an SDS archive in the -d directory,
+C                  YEAR/NET/STA/CHAN.D/NET.STA.LOC.CHAN.D.YEAR.DAY, adding
+C                  to day files already there (see sds.c); -s not used
 C
 C     By George Helffrich, U. Bristol, June 3-4, 2006
 C        updated 2 Sep. 2014
 C        updated 24 Feb. 2022
+C        updated 18 Oct. 2026
       program splitseed
-      parameter (mxbuf=8192, istmx=8, iucd=99)
+      parameter (mxbuf=65536, istmx=8)
       character posstr*16
       character cdname*256, fn*256, dname*64, nsta*5, nnet*2, lid*2
       character inbuf*(mxbuf), strm(istmx)*10, sname*18
-      integer lrecl, hmul, rec(istmx), hnow(istmx)
-      logical osta, onet, oign
+      integer lrecl, lrdef, hmul, rec(istmx), hnow(istmx)
+      logical osta, onet, oign, osds
       character posn*16
-      data osta, onet, oign /3*.false./, lid/'  '/
+      data osta, onet, oign, osds /4*.false./, lid/'  '/
 
       cdname = ' '
       dname = '.'
       hmul = 1
-      lrecl = 512
+      lrdef = 512
       n = 0
       iskip = 0
       do 5 i=1,iargc()
 	 if (i .le. iskip) go to 5
 	 call getarg(i,posn)
-	 if (posn(1:1) .eq. '-') then
+	 if (posn(1:1) .eq. '-' .and. posn .ne. '-') then
 	    if (posn .eq. '-d') then
 	       call getarg(i+1, dname)
 	       iskip = i+1
 	    else if (posn .eq. '-b') then
 	       call getarg(i+1,posn)
 	       ios = -1
-	       if (posn .ne. ' ') read(posn,*,iostat=ios) lrecl
+	       if (posn .ne. ' ') read(posn,*,iostat=ios) lrdef
 	       if (ios .ne. 0) stop '**Bad -b value'
-	       if (lrecl .gt. mxbuf) stop '**-b value too large'
+	       if (lrdef .gt. mxbuf) stop '**-b value too large'
 	       iskip = i+1
 	    else if (posn .eq. '-s') then
 	       call getarg(i+1,posn)
@@ -69,6 +81,8 @@ C        updated 24 Feb. 2022
 	       iskip = i+1
 	    else if (posn .eq. '-i') then
 	       oign = .true.
+	    else if (posn .eq. '-sds') then
+	       osds = .true.
 	    else
 	       write(0,*) '**Bad option: ',posn(1:index(posn,' ')-1)
 	       stop
@@ -82,25 +96,31 @@ C        updated 24 Feb. 2022
       ixd = index(dname,' ')-1
       if (ixd .lt. 0) ixd = len(dname)
 
-      open(iucd,file=cdname,
-     &   access='direct',
-     &   form='unformatted',
-     &   recl=lrecl,
-     &   iostat=ios)
+      call mszopn(cdname,iz,ios)
       if (ios .ne. 0) stop '**Bad file name, can''t open.'
+      if (osds) then
+         call sdsopn(dname,isd,ios)
+         if (ios .ne. 0) stop '**Can''t set up SDS archive.'
+      endif
       istrm = 0
 
       nprec = 1
+      nlast = 0
 10    continue
-	 read(iucd, rec=nprec, err=9100) inbuf(1:lrecl)
+	 call mszrd(iz,nprec,lrdef,inbuf,lrecl,ios)
+	 if (ios .ne. 0) go to 9100
+C        Sequence number follows the last (first may be anything)
 	 read(inbuf(1:6),*,iostat=ios) nrec
-	 if (ios .ne. 0 .or. nrec .ne. mod(nprec,1 000 000)) then
+	 if (ios .ne. 0 .or.
+     &      (nprec .gt. 1 .and. nrec .ne. mod(nlast+1,1 000 000))) then
 	    if (.not. oign) then
 	       write(0,*) '**Read error: blocks out of sequence.'
-	       write(0,*) '**Expecting ',nprec,' but got ',inbuf(1:6),'.'
+	       write(0,*) '**Expecting ',mod(nlast+1,1 000 000),
+     &            ' but got ',inbuf(1:6),'.'
 	       go to 9000
 	    endif
 	 endif
+	 nlast = nrec
 	 if (0 .eq. index('DRMQ',inbuf(7:7))) then
 	    write(0,*) '**Read error: block ',nprec,
      &         ' is not data block, but is ',inbuf(7:7),'.'
@@ -112,6 +132,19 @@ C        updated 24 Feb. 2022
 	       go to 10
 	    endif
 	 endif
+C        SDS archive files are named and numbered by the archive writer
+         if (osds) then
+            if (osta) inbuf(9:13) = nsta
+            if (onet) inbuf(19:20) = nnet
+            call sdswr(isd,inbuf,lrecl,ios)
+            if (ios .ne. 0) then
+               write(0,*) '**Unable to write block ',nprec,
+     &            ' to SDS archive.'
+               go to 9000
+            endif
+            nprec = nprec + 1
+            go to 10
+         endif
 C        Decode time.
          call tmdec(inbuf(21:30),iyr,ijd,ihr,imn,isc,ith)
 C        Check if a new stream
@@ -135,7 +168,7 @@ C    &      iyr,imo,idd,ihr,imn,isc,ith
          write(sname,'(i2.2,i2.2,i2.2,i2.2,i2.2,i2.2)')
      &      mod(iyr,100),imo,idd,ihr,imn,isc
          if (osta) inbuf(9:13) = nsta
-         if (onet) inbuf(14:15) = nnet
+         if (onet) inbuf(19:20) = nnet
 C        if (sname(15:16) .eq. '00') then
 C           iy = 14
 C        else
@@ -157,24 +190,22 @@ C        endif
      &      inbuf(9:ix) // sname(1:iy) // '.' // inbuf(16:18)
 	 open(10+is,
      &      file=fn,
-     &      recl=lrecl,
-     &      access='direct',
+     &      access='stream',
      &      form='unformatted',
      &      iostat=ios)
 	 if (ios .ne. 0) then
 	    write(0,*) '**Unable to open ',fn(1:index(fn,' ')),'oh oh.'
 	    go to 9000
 	 endif
-	 rec(istrm) = 0
-	 hnow(istrm) = (24*(ijd-1)+ihr)/hmul
+	 rec(is) = 0
+	 hnow(is) = (24*(ijd-1)+ihr)/hmul
 
 1100     continue
          rec(is) = rec(is) + 1
-	 write(inbuf(1:6),'(i6.6)') rec(is)
+	 write(inbuf(1:6),'(i6.6)') mod(rec(is),1 000 000)
          if (osta) inbuf(9:13) = nsta
-         if (onet) inbuf(14:15) = nnet
+         if (onet) inbuf(19:20) = nnet
 	 write(10+is,
-     &      rec=rec(is),
      &      iostat=ios) inbuf(1:lrecl)
 	 if (ios .ne. 0) then
 	    write(0,*) '**Unable to write ',fn(1:index(fn,' ')),
@@ -189,7 +220,11 @@ C        endif
       write(*,*) nprec-1,' blocks read.'
 
 9000  continue
-      close(iucd)
+      call mszcls(iz)
+      if (osds) then
+         call sdscls(isd,ios)
+         if (ios .ne. 0) write(0,*) '**Error closing SDS archive files.'
+      endif
       do i=1,istrm
 	 close(10+i)
       enddo
@@ -7,27 +7,123 @@
              9 Feb. 2023
             11 Feb. 2023
             17 Feb. 2023
+            18 Oct. 2026
 
-Usage:  tv3mseed {-v | -z <file> | -n <file> | -e <file> |
-                  -l [+|-] [jun|dec] <year>} ... <store>
+Usage:  tv3mseed {-v | -z <file> | -n <file> | -e <file> | -all <prefix> |
+                  -sds <dir> | -map <band>:<chan>[:<loc>] | -w <file> | -c |
+                  -resync | -pipe | -ckpt <file> [-resume] | -img <dev> |
+                  -follow <file> [-poll <sec>] | -stats | -tears <file> |
+                  -tearfix | -l [+|-] [jun|dec] <year>} ... <store> ...
 
 Command line parameters:
    -h - usage (this text)
-   -v - verbose output
+   -v - verbose output (-v -v also lists each store section)
+   -stats - report counts and timings on the standard error output at the
+      end of the run, or while it runs, if sent a USR1 signal:  bytes read,
+      packets of each band, packets skipped, blockettes written for each
+      component, and the time spent reading the store, decoding packets and
+      writing output, with the extraction rate.  If the reading time
+      dominates the run is disk-bound; otherwise it is CPU- or output-bound.
+   -resync - Recover from damaged packets.  Without this, a bad packet
+      header or a short read stops extraction.  With it, the store is
+      scanned forward for the next plausible packet (correct magic, sane
+      size, time within a day of the last good packet) or the end of the
+      cluster, the byte range skipped is reported, and extraction goes on.
+      Unrecognized store sections are skipped too.
+   -pipe - Pipelined extraction:  one thread reads the store, another
+      decodes the packets and makes the blockettes, and one more for each
+      output file writes them, each stage passing its work on to the next
+      through a ring buffer.  Reading, decoding, compression (with -c) and
+      writing then overlap, on a machine with the CPUs to spare; the output
+      is the same as without.  SOH output is written by the decoding thread,
+      so may not share a file with data.  -stats times are then those of
+      each thread, and overlap.
    -z <file> - Dump MSEED blockettes for Z component to named file
    -n <file> - Dump MSEED blockettes for N component to named file
    -e <file> - Dump MSEED blockettes for E component to named file
+      Any output <file> may be "-" for the standard output, or a named pipe.
+      Components sent to the same standard output are interleaved, e.g.
+         tv3mseed -z - -n - -e - <store> | splitseed -i -s 1d -d pool -
+      runs extraction and splitting together without intermediate files.
+   -all <prefix> - Dump MSEED blockettes for every data channel in the store
+      (other than those given -z, -n or -e files) to a file named by the
+      prefix, the location code and a dot if there is one, and the channel
+      code, e.g. -all out/ makes out/BHZ, out/BHN, out/BHE, out/10.HHZ ...
+      A prefix of - sends them all to the standard output.
+   -sds <dir> - Write every data channel not given its own output file into
+      an SDS archive in directory <dir>, one file per channel and day:
+         <dir>/YEAR/NET/STA/CHAN.D/NET.STA.LOC.CHAN.D.YEAR.DAY
+      Blockettes holding data from both sides of a midnight are split there,
+      so each day file holds only its own day's data.  Day files already
+      there are added to, with only blockettes starting after their last
+      one, so an archive can be brought up to date by extracting into it
+      again (e.g. with -follow).  Not possible with -tearfix.
+   -map <band>:<chan>[:<loc>] - SEED channel and location code for data in
+      packet band <band>, e.g. -map 73:HHZ:10.  Bands 65, 67 and 69 are
+      BHZ, BHN and BHE unless mapped; other bands (a second sensor, high rate
+      channels) are named when first seen from their sample rate:  SEED band
+      code H (80 sps or more), B (10 or more), L (1 or more), V or U, then H
+      and a number, e.g. HH1, HH2, ..., which is reported.
+   -c - Compress MSEED output (-z, -n, -e, and -soh with -fmt mseed).  The
+      records are compressed in independent frames of 128 records each, so
+      that mseedsort, splitseed and mseedgap, which read compressed files as
+      well as uncompressed ones, can still get at any record directly.
+      mszcat decompresses a file for other tools.
+   -ckpt <file> - Write a restart checkpoint to <file> every 256 MB read from
+      the store:  the place in the allocation table and cluster reached, the
+      length of each output file and each component's blockette number, and
+      the SOH blockette being built.  Outputs are flushed to disk first.
+      The file is removed when the extraction finishes.
+   -resume - Restart an interrupted extraction from the -ckpt file's
+      checkpoint.  Give the same outputs and options as the interrupted run;
+      the outputs are cut back to their checkpointed lengths and extraction
+      continues from there, yielding the same result as an uninterrupted run.
+      Not possible with -c or output to the standard output.
+   -follow <file> - Follow a store that is still growing, e.g. a mirror of a
+      recording datalogger's store.  Packets are extracted up to the end of
+      what has been written so far, and the place reached, with the output
+      lengths and the blockettes being built, is kept in the state <file>.
+      Run again with the same outputs and options, only what has been added
+      to the store since is extracted and appended to the outputs.  A section
+      or packet that is not yet completely written is left for the next run.
+      The last SOH blockette, still being filled, is kept in the state file
+      rather than written.  Not possible with -c, -ckpt or output to the
+      standard output.
+   -poll <sec> - With -follow, do not stop at the end of the store but check
+      every <sec> seconds for new data in it, and extract it when seen.
+      The outputs and state file are brought up to date after each pass.
+   -img <dev> - Read the store from the ext2 file system on <dev>, a disk
+      image (e.g. made with dd from a Taurus's data disk) or the disk's block
+      device itself, without mounting it.  <store> is then the store file's
+      path in that file system, e.g. /store/taurus_0665_001.store, or just
+      its name, in which case the file system is searched for it.
    -S <name> - Explicitly set station name
    -N <name> - Explicitly set network ID
    -soh <file> - Dump SOH detail in named file
-   -sohdt <sec> - SOH sampling is every <sec> seconds (default 60)
+   -sohdt <sec> - SOH sampling is every <sec> seconds.  By default the
+      interval is found from the SOH packet times (the median of the last
+      15 intervals), so that it follows changes in the Taurus configuration.
+      Packet times within a quarter interval of the regular sampling grid are
+      taken to be on it; a new MSEED record is only started at a real gap,
+      a change of interval, or when a record is full.
    -item {T|Z|N|E|V|P} - SOH item to dump.  Encoding:
       T - temperature in logger (C)
       V - power supply voltage (mV)
       P - GPS-reported position (deg N, deg E) [text-only option]
       Z, N, E - mass position (V)
-   -fmt {text|mseed} - SOH dump format; one is human-readable, the other is
-      a time series of MSEED data packets.
+   -fmt {text|mseed|csv|col} - SOH dump format:  text is human-readable,
+      mseed a time series of MSEED data packets, both of the -item chosen.
+      csv and col give every known SOH field (position, temperature, mass
+      positions, supply voltage) with no -item needed; csv as a line per
+      SOH packet, col as a compact binary column file for health analysis
+      over long spans.  col is written in blocks of up to 4096 packets:
+         "SOHC", station (5 bytes), network (2), no. of columns (1),
+         no. of rows (4), then for each column its name (8, blank filled)
+         and type (1: l, i, f or s for 64 or 32-bit integer, 32-bit float
+         or 16-bit integer), then each column's values in turn.
+      Values are big-endian; columns time (ns since 1970), lat, lon
+      (microdegrees), temp, mass1, mass2, mass3, supply; missing values are
+      NaN or the most negative integer.
    -l [+|-] [jun|dec] <year> - Describe leap second in store time
       span.  Data in blockettes spanning the leap second will be
       flagged appropriately in the Activity field of the blockette so that
@@ -35,9 +131,43 @@ Command line parameters:
       and year of application must be specified, e.g.
          -l + jun 2012
       describes the June 2012 leap second (positive).
+   -tears <file> - Check each data channel's packet times as they are read
+      against the time predicted from the previous packet's time, sample
+      count and rate, and list the time tears (jumps of more than half a
+      sample:  whole seconds when the Taurus clock relocks to GPS after
+      missing a leap second, a fraction of a second when it relocks after
+      drifting unlocked, or a gap in the data) and changes of clock status
+      in the file, one per line:
+         tear <sta> <loc> <chan> <time> <jump (s)>
+         clock <sta> <loc> <chan> <time> <old status> <new status>
+      with the location code as -- if blank, and the time that of the
+      first packet after the change.  Status is none, incorrect, unlocked
+      or locked.
+   -tearfix - With -l, correct the time stamps of data mistimed around the
+      leap second, as tv[23]msleapfix do by hand.  Data from the leap
+      second to the first one second tear after it that undoes it (Taurus
+      v3.x), or from the last one second tear before it in its sense
+      (Taurus v2.x) to the leap second, are moved back by one second.  The
+      output files are rewritten in place at the end of the run; the -tears
+      file gets a line for each channel fixed:
+         fix <sta> <loc> <chan> <from> <to> <shift (s)> <records>
+      Not possible with -c, -ckpt or output to the standard output.
+   -w <file> - Only extract packets with data in the time windows listed in
+      the file.  Each line gives a window's start and end time as
+         yyyy/mm/dd[Thh:mm[:ss]] yyyy/mm/dd[Thh:mm[:ss]]
+      Windows may overlap and be in any order; lines starting with # are
+      ignored.  Hundreds of event windows may be cut in one pass this way.
    <store> - store file to search.  This should be the first store file in
       the group describing a store, and a name that includes the suffix
       "001.store"  The rest of the store's file names are derived from this.
+      Several stores for the same station (e.g. from before and after a
+      Taurus was swapped or rebooted in the field) may be given, to be
+      merged:  their packets are read together in time order, each store's
+      clusters by the time of their first packet (so a store that has
+      rolled over is read oldest first), and a packet found in more than
+      one of them is extracted only once.  The output is then one time
+      sequence, as if from a single store.  Not possible with -ckpt or
+      -follow.
 
    Data packets and requested SOH packets are extracted and converted to MSEED.
    Any packets not associated with a file to receive them are skipped.  Thus it
@@ -49,6 +179,7 @@ Command line parameters:
 
 */
 
+#define _GNU_SOURCE                /* For F_SETPIPE_SZ */
 #include <unistd.h>
 #include <stdlib.h>
 #include <stdint.h>
@@ -56,12 +187,34 @@ Command line parameters:
 #include <string.h>
 #include <math.h>
 #include <time.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/stat.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <sched.h>
+#include <zlib.h>
+#include "msrec.h"
+#include "msz.h"
+#include "ext2.h"
+#include "sds.h"
 
 #define HDRSIZ 36
+#define PIPSIZ 0x100000            /* Pipe buffer size to ask for */
+#define OBUFSIZ 0x10000            /* Output buffer size */
+#define RSYNBUF 0x10000            /* Chunk read when resynchronizing */
+#define PKTMIN 32                  /* Plausible packet sizes */
+#define PKTMAX 0x10000
+#define PKTBUF 0x100000            /* Packet read buffer size */
+#define RSYNDT 86400000000000ULL   /* Plausible time jump (ns) */
 
 char *prog;
 
-short verb = 0, lpsc = 0;
+FILE *msgs;                        /* Where verbose output goes */
+
+short verb = 0, lpsc = 0, zout = 0, stats = 0, rsyn = 0, pipl = 0, follow = 0;
+int pollsec = 0;                   /* -poll interval (s) */
+struct e2fs *img = NULL;           /* -img file system */
 
 char snam[5], snet[2];
 
@@ -77,7 +230,9 @@ enum soh_info {
 
 enum soh_format {
    SOH_FMT_TEXT,
-   SOH_FMT_MSEED
+   SOH_FMT_MSEED,
+   SOH_FMT_CSV,
+   SOH_FMT_COL
 } soh_fmt = SOH_FMT_TEXT;
 
 struct si {
@@ -98,59 +253,169 @@ struct sf {
    enum soh_format val;
 } soh_fmts[] = {
    { "text", SOH_FMT_TEXT},
-   { "mseed", SOH_FMT_MSEED}
+   { "mseed", SOH_FMT_MSEED},
+   { "csv", SOH_FMT_CSV},
+   { "col", SOH_FMT_COL}
 };
 #define N_SOHF (sizeof(soh_fmts)/sizeof(struct sf))
 
+/* SOH field datatypes (blockette 1000 codes) */
+enum soh_type {XX, LL = 11, HW = 1, FW = 3, FL = 4};
+
+/* Known SOH fields:  type of payload item holding it, its offset in the
+   item, its datatype, the -item that selects it and its column name */
+struct sohf {
+   short type, off;
+   enum soh_type dt;
+   enum soh_info itm;
+   char *name;
+} sohflds[] = {
+   {0x0127,  7, FL, SOH_TEMP,     "temp"},     /* Environmental */
+   {0x0192,  9, FL, SOH_MASS1_V,  "mass1"},    /* Sensor SOH */
+   {0x0192, 18, FL, SOH_MASS2_V,  "mass2"},
+   {0x0192, 27, FL, SOH_MASS3_V,  "mass3"},
+   {0x012b, 19, HW, SOH_SUPPLY_V, "supply"},   /* Power */
+};
+#define N_SOHFLD (sizeof(sohflds)/sizeof(struct sohf))
+
+/* -fmt col output:  rows collected in blocks of up to SOHCBLK, each
+   written column by column */
+#define SOHCBLK 4096
+struct {
+   int n;
+   uint64_t tim[SOHCBLK];
+   int lat[SOHCBLK], lon[SOHCBLK];
+   int val[N_SOHFLD][SOHCBLK];
+} sohc;
+
 struct sloc {
    int lat, lon;
 };
 
 time_t lptm;
 
+/* Time tear detection (-tears) and correction (-tearfix) */
+#define SEC 1000000000ll
+FILE *tearfd = NULL;
+char *tearfn = NULL;
+short tfix = 0;
+
 struct sstate {
    FILE *fd;
-   char *chid;
+   char chid[4];                   /* SEED channel code */
+   char loc[3];                    /* SEED location code */
    int blkno;
    char msg;
+   char named;                     /* Codes set (by -map or first sight) */
+   int band;                       /* Packet band */
+   char *fn;                       /* Output file name */
+   long long ckl;                  /* Output length at checkpoint */
+   char hset;                      /* Header template made */
+   unsigned char hdr[64];          /* MSEED header template */
+   uint64_t tnext;                 /* Predicted time of next packet */
+   unsigned char clk;              /* Clock status of last packet */
+   int64_t tr0, tr1;               /* Mistimed by leap second (-tearfix) */
+   long long nfix;                 /* Records whose times were fixed */
+   struct ring *wr;                /* Writer thread's ring (-pipe) */
 };
 
-struct sstate strm[3] = {
-   {NULL, "BHZ", 1, 1},
-   {NULL, "BHN", 1, 1},
-   {NULL, "BHE", 1, 1},
-};
+/* Data streams, allocated on first sight of a band (or when named in an
+   option); bndix[band] is the stream's index+1, or 0 if none yet */
+struct sstate *strm = NULL;
+int nstrm = 0, mstrm = 0;
+short bndix[256];
+char *allpfx = NULL;               /* -all output file name prefix */
+struct sds *sds = NULL;            /* -sds archive */
 
 struct sstate sohd = {
-   NULL, "SOH", 1, 1
+   NULL, "SOH", "  ", 1, 1, 1, 71, NULL, -1, 0
 };
 
+/* Time windows to extract, sorted and merged so that they don't overlap */
+struct win {
+   uint64_t t0, t1;
+} *wins = NULL;
+int nwin = 0;
+
+/* Run statistics (-stats) */
+struct {
+   uint64_t bytes, band[256], skip;
+   uint64_t lost, nrsyn;           /* Bytes skipped resynchronizing, times */
+   uint64_t ndup;                  /* Duplicate packets dropped merging */
+   double tio, tdec, twrt;         /* Time reading, decoding, writing (s) */
+   double t0;                      /* Start of run */
+} st;
+volatile sig_atomic_t strep = 0;   /* Report requested by signal */
+
 /* Blockette buffer for SOH output in MSEED data form */
 uint64_t sohtim;
-int sohblk = 0, sohdt = 60, sohcnt = 0;
+int sohblk = 0, sohdt = 0, sohcnt = 0;
 unsigned char sohmsd[512];
 
+/* SOH sample interval:  fixed by -sohdt, or else estimated as the median
+   of the last NSOHDT intervals between SOH packets.  A record's samples lie
+   on a grid of its interval from its first sample's time, sohrt0. */
+#define NSOHDT 15
+#define SOHDEF 60                  /* Interval if there is nothing to go on */
+int sohdts[NSOHDT], nsohdt = 0;    /* Recent intervals (ms) */
+int sohrdt = 0;                    /* Record's interval (s) */
+uint64_t sohrt0;
+
+/* Checkpoints (-ckpt, -resume):  where to restart, and output lengths */
+#define CKPTSIZ 0x10000000         /* Checkpoint every this many bytes read */
+char *ckfile = NULL;
+short resume = 0;
+struct {
+   int ix;                         /* Allocation table index */
+   off_t off;                      /* Next packet in section (0 if none) */
+} ck = {0, 0};
+
 void usage(){
    char *msg =
-   " {-h | -v | -z <file> | -n <file> | -e <file> |\n"
-   "        -soh <file> -item <itms> | -l [+|-] [jun|dec] <year>} ... <store>\n"
+   " {-h | -v | -z <file> | -n <file> | -e <file> | -all <prefix> |\n"
+   "        -sds <dir> | -map <band>:<chan>[:<loc>] | -w <file> | -c |\n"
+   "        -resync | -pipe | -ckpt <file> [-resume] | -img <dev> |\n"
+   "        -follow <file> [-poll <sec>] | -stats | -tears <file> |\n"
+   "        -tearfix | -soh <file> -item <itms> |\n"
+   "        -l [+|-] [jun|dec] <year>} ... <store> ...\n"
    " Options:\n"
    "   -h - usage (this text)\n"
    "   -v - verbose output (repeat for more verbosity)\n"
+   "   -stats - report counts and timings at end (or on USR1 signal)\n"
+   "   -resync - skip damaged packets rather than stopping\n"
+   "   -pipe - read, decode and write output in separate threads\n"
    "   -z <file> - Dump MSEED blockettes for Z component to named file\n"
    "   -n <file> - Dump MSEED blockettes for N component to named file\n"
    "   -e <file> - Dump MSEED blockettes for E component to named file\n"
+   "      (any output <file> may be - for standard output, or a named pipe)\n"
+   "   -all <prefix> - Dump all other data channels, each to <prefix><chan>\n"
+   "      (or <prefix><loc>.<chan> if there is a location code)\n"
+   "   -sds <dir> - Write data channels without an output file into an SDS\n"
+   "      archive in <dir> (day files, added to if already there)\n"
+   "   -map <band>:<chan>[:<loc>] - SEED channel and location codes for\n"
+   "      data in packet band <band> (65, 67, 69 are BHZ, BHN, BHE unless\n"
+   "      mapped; others are named from their sample rate)\n"
+   "   -c - Compress MSEED output files (in frames of 128 records)\n"
+   "   -ckpt <file> - Write restart checkpoints to file as extraction runs\n"
+   "   -resume - Restart extraction from -ckpt file's last checkpoint\n"
+   "   -follow <file> - Extract only what was added to a growing store since\n"
+   "      the last run, keeping the place reached in <file>\n"
+   "   -poll <sec> - With -follow, check for new data every <sec> seconds\n"
+   "   -img <dev> - Read store from ext2 file system image or device <dev>\n"
+   "      without mounting it\n"
    "   -S <name> - Explicitly set station name\n"
    "   -N <name> - Explicitly set network ID\n"
    "   -soh <file> - Dump SOH detail in named file.\n"
-   "   -sohdt <sec> - SOH sampling is every <sec> seconds (default 60)\n"
+   "   -sohdt <sec> - SOH sampling is every <sec> seconds (default: from\n"
+   "      the SOH packet times)\n"
    "   -item {T|Z|N|E|V|P} - SOH item to dump.  Encoding:\n"
    "      T - temperature in logger (C)\n"
    "      V - power supply voltage (mV)\n"
    "      P - position (lat N, lon E, elev m) [text-only option]\n"
    "      Z, N, E - mass position (V)\n"
-   "   -fmt {text|mseed} - SOH dump format; one is human-readable, the other\n"
-   "      is a time series of MSEED data packets.\n"
+   "   -fmt {text|mseed|csv|col} - SOH dump format; text is human-readable,\n"
+   "      mseed a time series of MSEED data packets.  csv and col give all\n"
+   "      SOH fields as CSV lines or a binary column file (-item not used).\n"
    "   -l [+|-] [jun|dec] <year> - Describe leap second in store time\n"
    "      span.  Data in blockettes spanning the leap second will be flagged\n"
    "      appropriately in the Activity field of the blockette so that\n"
@@ -158,10 +423,17 @@ void usage(){
    "      and year of application must be specified, e.g.\n"
    "         -l + jun 2012\n"
    "      describes the June 2012 leap second (positive).\n"
+   "   -tears <file> - List time tears and clock status changes in file\n"
+   "   -tearfix - With -l, correct times of data mistimed around the leap\n"
+   "      second, up to (or from) the tear where the clock was corrected\n"
+   "   -w <file> - Only extract packets with data in time windows listed\n"
+   "      in file, one window per line:\n"
+   "         yyyy/mm/dd[Thh:mm[:ss]] yyyy/mm/dd[Thh:mm[:ss]]\n"
    "   <store> - store file to search.  This should be the first store file\n"
    "      in a group describing a store, and a name that includes the suffix\n"
    "      \"001.store\"  The rest of the store's file names are derived from\n"
-   "      this.\n";
+   "      this.  If several stores are given, they are merged in time\n"
+   "      order, with packets found in more than one taken only once.\n";
    fprintf(stderr, "Usage: %s%s", prog, msg);
    fflush(stderr);
 }
@@ -204,52 +476,687 @@ void pfw(unsigned char *p, int v){
    p[1] = (v >> 16) & 0xff; p[0] = (v >> 24) & 0xff;
 }
 
+void pdw(unsigned char *p, uint64_t v){
+   pfw(p, v >> 32); pfw(p+4, v & 0xffffffff);
+}
+
+/* Sample rate from SEED rate factor and multiplier */
+
+double srate(int srf, int srm){
+   return (srf>0 && srm>0) ?  srf*srm :
+          (srf>0 && srm<0) ? -(double)srf/srm :
+          (srf<0 && srm>0) ? -(double)srm/srf : 1/((double)srf*srm);
+}
+
+/* Open output file.  "-" means standard output.  Pipes get a large buffer
+   so that a reader on the other end doesn't stall extraction. */
+
+FILE *opnout(char *name, char *mode){
+   FILE *fd;
+   struct stat sb;
+
+   if (0 == strcmp(name, "-")) {
+      fd = stdout;
+      msgs = stderr;
+   } else
+      fd = fopen(name, mode);
+   if (fd == NULL) return NULL;
+   if (0 == fstat(fileno(fd), &sb) && S_ISFIFO(sb.st_mode)) {
+#ifdef F_SETPIPE_SZ
+      (void)fcntl(fileno(fd), F_SETPIPE_SZ, PIPSIZ);
+#endif
+   }
+   if (fd != stdout || !isatty(fileno(fd)))
+      (void)setvbuf(fd, NULL, _IOFBF, OBUFSIZ);
+   return fd;
+}
+
+/* Monotonic clock, for timings */
+
+double now(){
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return ts.tv_sec + 1e-9*ts.tv_nsec;
+}
+
+void onusr1(int sig){
+   strep = 1;
+}
+
+/* Report run statistics */
+
+void stprt(){
+   double el = now() - st.t0, mb = st.bytes/1048576.0;
+   int i;
+
+   fprintf(stderr, "%s: %.1f MB read in %.2f s, %.1f MB/s\n",
+      prog, mb, el, el > 0 ? mb/el : 0.0);
+   fprintf(stderr, "%s: packets", prog);
+   for(i=0; i<256; i++)
+      if (st.band[i]) fprintf(stderr, " band %d: %llu", i,
+         (unsigned long long)st.band[i]);
+   fprintf(stderr, ", skipped: %llu\n", (unsigned long long)st.skip);
+   if (st.nrsyn) fprintf(stderr, "%s: resynchronized %llu times, "
+      "%llu bytes lost\n", prog, (unsigned long long)st.nrsyn,
+      (unsigned long long)st.lost);
+   if (st.ndup) fprintf(stderr, "%s: duplicate packets dropped: %llu\n",
+      prog, (unsigned long long)st.ndup);
+   fprintf(stderr, "%s: blockettes", prog);
+   for(i=0; i<nstrm; i++)
+      fprintf(stderr, " %s%s%s %d", strm[i].loc[0] == ' ' ? "" : strm[i].loc,
+         strm[i].loc[0] == ' ' ? "" : ".", strm[i].chid, strm[i].blkno-1);
+   fprintf(stderr, " %s %d\n", sohd.chid, sohblk);
+   fprintf(stderr, "%s: time read %.2f s, decode %.2f s, write %.2f s, "
+      "other %.2f s\n", prog, st.tio, st.tdec - st.twrt, st.twrt,
+      el - st.tio - st.tdec);
+   fflush(stderr);
+}
+
+/* Pipelined extraction (-pipe):  one thread reads the store and passes
+   the packets to the decoding thread through a ring; the blockettes for
+   each output file go through another ring to a thread that writes them.
+   The rings have one producer and one consumer each, so need no locks:
+   the producer alone advances head, the consumer alone tail.  A producer
+   with a full ring waits, so no stage runs too far ahead of the next.
+   An entry never wraps around the end of the ring; it runs on into
+   slack space after it instead. */
+#define PRNGSIZ 0x400000           /* Packet ring size (bytes) */
+#define WRNGSIZ 0x100000           /* Blockette ring size (bytes) */
+
+struct ring {
+   unsigned char *buf;
+   size_t siz;                     /* Size, without slack at end */
+   _Atomic size_t head, tail;      /* Bytes put in, taken out */
+   _Atomic int eof;                /* Producer finished */
+   FILE *fd;                       /* Output (writer rings) */
+   pthread_t tid;                  /* Thread at other end */
+};
+
+/* Packet ring entry header */
+struct pent {
+   size_t len;                     /* Entry length, header and all */
+   int ix;                         /* Allocation table index */
+   off_t off, next;                /* Packet offset, next packet's */
+   size_t siz;                     /* Packet size */
+};
+
+struct ring pkts;
+
+struct ring *mkring(struct ring *r, size_t siz, size_t slack){
+   if (r == NULL) r = malloc(sizeof(struct ring));
+   if (r == NULL) err("pipeline setup error");
+   memset(r, 0, sizeof(struct ring));
+   r->buf = malloc(siz + slack);
+   if (r->buf == NULL) err("pipeline setup error");
+   r->siz = siz;
+   return r;
+}
+
+/* Wait a while for the other end of a ring */
+
+void rngwait(int *n){
+   struct timespec ts = {0, 50000};
+   if ((*n)++ < 100)
+      sched_yield();
+   else
+      nanosleep(&ts, NULL);
+}
+
+/* Space for an n byte entry, waiting until there is room */
+
+unsigned char *rngput(struct ring *r, size_t n){
+   size_t h = atomic_load_explicit(&r->head, memory_order_relaxed);
+   int w = 0;
+
+   while (h + n - atomic_load_explicit(&r->tail, memory_order_acquire)
+          > r->siz)
+      rngwait(&w);
+   return r->buf + (h & (r->siz-1));
+}
+
+/* Entry of n bytes put in */
+
+void rngpost(struct ring *r, size_t n){
+   atomic_fetch_add_explicit(&r->head, n, memory_order_release);
+}
+
+/* Next entry, waiting until there is one; NULL when the producer is
+   finished and the ring empty */
+
+unsigned char *rngget(struct ring *r){
+   size_t t = atomic_load_explicit(&r->tail, memory_order_relaxed);
+   int w = 0;
+
+   while (t == atomic_load_explicit(&r->head, memory_order_acquire)) {
+      if (atomic_load_explicit(&r->eof, memory_order_acquire)
+       && t == atomic_load_explicit(&r->head, memory_order_acquire))
+         return NULL;
+      rngwait(&w);
+   }
+   return r->buf + (t & (r->siz-1));
+}
+
+/* Entry of n bytes taken out */
+
+void rngdone(struct ring *r, size_t n){
+   atomic_fetch_add_explicit(&r->tail, n, memory_order_release);
+}
+
+/* Writer thread:  blockettes from the ring to the output file */
+
+void *writer(void *arg){
+   struct ring *r = arg;
+   unsigned char *p;
+
+   while ((p = rngget(r))) {
+      if (1 != fwrite(p, 512, 1, r->fd)) err("Error writing blockette");
+      rngdone(r, 512);
+   }
+   return NULL;
+}
+
+/* Start a writer thread for a stream's output file */
+
+void mkwriter(struct sstate *s){
+   s->wr = mkring(NULL, WRNGSIZ, 0);
+   s->wr->fd = s->fd;
+   if (pthread_create(&s->wr->tid, NULL, writer, s->wr))
+      err("can't start writer thread");
+}
+
+/* Wait until the writer threads have written everything given them */
+
+void drain(){
+   int i, w;
+
+   for(i=0; i<nstrm; i++) {
+      struct ring *r = strm[i].wr;
+      if (r == NULL) continue;
+      w = 0;
+      while (atomic_load_explicit(&r->tail, memory_order_acquire)
+          != atomic_load_explicit(&r->head, memory_order_acquire))
+         rngwait(&w);
+   }
+}
+
+/* Finish the writer threads */
+
+void wrstop(){
+   int i, j;
+
+   for(i=0; i<nstrm; i++) {
+      struct ring *r = strm[i].wr;
+      if (r == NULL) continue;
+      atomic_store_explicit(&r->eof, 1, memory_order_release);
+      if (pthread_join(r->tid, NULL)) err("can't finish writer thread");
+      for(j=i; j<nstrm; j++) if (strm[j].wr == r) strm[j].wr = NULL;
+      free(r->buf); free(r);
+   }
+}
+
+/* Stream table.  sst(i) for i from 0 to nstrm runs through the data
+   streams and then the SOH stream. */
+
+struct sstate *sst(int i){
+   return i < nstrm ? strm+i : &sohd;
+}
+
+/* Find a band's stream, making a new one if it hasn't been seen.  The
+   original three bands have their usual channel codes. */
+
+int getstrm(int band){
+   struct sstate *s;
+
+   if (bndix[band]) return bndix[band]-1;
+   if (nstrm >= mstrm) {
+      mstrm = mstrm ? 2*mstrm : 8;
+      strm = realloc(strm, mstrm*sizeof(struct sstate));
+      if (strm == NULL) err("stream table error");
+   }
+   s = strm+nstrm;
+   memset(s, 0, sizeof(struct sstate));
+   s->band = band; s->blkno = 1; s->msg = 1; s->ckl = -1;
+   strcpy(s->loc, "  ");
+   if (band == 65 || band == 67 || band == 69) {
+      sprintf(s->chid, "BH%c", "ZNE"[(band-65)>>1]);
+      s->named = 1;
+   }
+   bndix[band] = ++nstrm;
+   return nstrm-1;
+}
+
+/* Output file name for a stream under -all:  prefix, location code (if
+   any) and channel code, e.g. out/BHZ or out/10.HHZ */
+
+void mkfn(struct sstate *s){
+   if (0 == strcmp(allpfx, "-")) {
+      s->fn = "-";
+      return;
+   }
+   s->fn = malloc(strlen(allpfx)+8);
+   if (s->fn == NULL) err("stream table error");
+   sprintf(s->fn, "%s%s%s%s", allpfx, s->loc[0] == ' ' ? "" : s->loc,
+      s->loc[0] == ' ' ? "" : ".", s->chid);
+}
+
+/* Open a stream's output file.  Streams given the same file name share an
+   output.  When resuming, a file written before the checkpoint is opened
+   for update and cut back to its checkpointed length; anything written
+   after the checkpoint is written again. */
+
+void opnstrm(struct sstate *s){
+   int i, upd = resume && s->ckl >= 0;
+
+   for(i=0; i<=nstrm; i++) {
+      struct sstate *t = sst(i);
+      if (t != s && t->fd && t->fn && 0 == strcmp(t->fn, s->fn)) {
+         if (pipl && (s == &sohd || t == &sohd))
+	    err("-pipe not possible with SOH and data in the same output");
+         s->fd = t->fd; s->wr = t->wr;
+	 return;
+      }
+   }
+   s->fd = opnout(s->fn, upd ? "r+" : "w");
+   if (s->fd == NULL) {
+      fprintf(stderr, "%s: can't open %s\n", prog, s->fn);
+      err("bad output file name");
+   }
+   if (upd && (ftruncate(fileno(s->fd), (off_t)s->ckl)
+            || fseeko(s->fd, (off_t)s->ckl, SEEK_SET)))
+      err("can't truncate output file to checkpoint");
+   if (zout && (s != &sohd || soh_fmt == SOH_FMT_MSEED)) {
+      s->fd = mszout(s->fd, 512);
+      if (s->fd == NULL) err("can't set up compressed output");
+   }
+   if (pipl && s != &sohd) mkwriter(s);
+}
+
+/* Open the output files of the streams known at the start */
+
+void opnall(){
+   int i;
+
+   for(i=0; i<=nstrm; i++) {
+      struct sstate *s = sst(i);
+      if (s != &sohd && s->fn == NULL && allpfx) mkfn(s);
+      if (resume && (s->fn != NULL) != (s->ckl >= 0))
+         err("outputs differ from checkpointed run");
+      if (s->fn) opnstrm(s);
+   }
+}
+
+/* First sight of a data band:  make its stream, naming it from its sample
+   rate (H, B, L, V or U band code, then H and the first number 1-9 that no
+   other stream has) unless -map named it, and open its output under -all */
+
+int newstrm(int band, unsigned char pay[]){
+   int i, ix = getstrm(band);      /* (May move the table) */
+   struct sstate *s = strm+ix;
+
+   if (!s->named) {
+      double sr = srate(pay[4], pay[5]);
+      s->chid[0] = sr >= 80 ? 'H' : sr >= 10 ? 'B' : sr >= 1 ? 'L' :
+         sr >= 0.1 ? 'V' : 'U';
+      s->chid[1] = 'H'; s->chid[3] = 0;
+      for(s->chid[2]='1'; s->chid[2]<='9'; s->chid[2]++) {
+         for(i=0; i<nstrm; i++)
+	    if (i != ix && strm[i].named && 0 == strcmp(strm[i].chid, s->chid)
+	     && 0 == strcmp(strm[i].loc, s->loc)) break;
+	 if (i >= nstrm) break;
+      }
+      if (s->chid[2] > '9') {
+         char msg[64];
+	 sprintf(msg, "band %d data:  no channel code left, use -map", band);
+	 err(msg);
+      }
+      s->named = 1;
+      fprintf(stderr, "%s: band %d data named %s (-map to change)\n",
+         prog, band, s->chid);
+   }
+   if (s->fn == NULL && allpfx) {
+      mkfn(s);
+      opnstrm(s);
+   }
+   return s-strm;
+}
+
+/* Decode all known fields of a SOH packet's payload into val[]; returns
+   which were found as bits in the result.  Floats are kept as their bits,
+   half-words sign extended. */
+
+int sohdec(int buflen, unsigned char buf[], int val[]){
+   size_t off = 0;
+   int i, have = 0;
+
+   while (off + 4 <= buflen) {
+      short siz = hw(buf+off) & 0x1fff, type = hw(buf+off+2);
+      if (siz <= 0) break;
+      for(i=0; i<N_SOHFLD; i++) {
+	 struct sohf *f = sohflds+i;
+         if (f->type != type || off + f->off + (f->dt == HW ? 2 : 4) > buflen)
+	    continue;
+	 val[i] = f->dt == HW ? (short)hw(buf+off+f->off) : fw(buf+off+f->off);
+	 have |= 1<<i;
+      }
+      off += siz;
+   }
+   return have;
+}
+
+/* Write a block of -fmt col output:
+      "SOHC", station (5), network (2), no. of columns (1), no. of rows (4)
+   then for each column its name (8, blank filled) and type (1):  l 64-bit
+   integer, i 32-bit integer, f 32-bit float, s 16-bit integer; then each
+   column's values in turn.  All big-endian, like MSEED.  Columns are the
+   time (ns since 1970), lat and lon (microdegrees) and the fields in
+   sohflds[].  Missing values are NaN or the most negative integer. */
+
+void sohcput(){
+   unsigned char h[16], *p;
+   char name[9];
+   size_t n = sohc.n;
+   int i, j;
+
+   if (n == 0) return;
+   memcpy(h, "SOHC", 4);
+   memcpy(h+4, sohmsd+8, 5); memcpy(h+9, sohmsd+18, 2);
+   h[11] = 3 + N_SOHFLD; pfw(h+12, n);
+   if (1 != fwrite(h, 16, 1, sohd.fd)) goto wrerr;
+   for(i=0; i<h[11]; i++) {
+      char *nm = i == 0 ? "time" : i == 1 ? "lat" : i == 2 ? "lon" :
+         sohflds[i-3].name;
+      snprintf(name, sizeof(name), "%-8s", nm);
+      name[8] = i == 0 ? 'l' : i < 3 ? 'i' :
+         sohflds[i-3].dt == HW ? 's' : 'f';
+      if (1 != fwrite(name, 9, 1, sohd.fd)) goto wrerr;
+   }
+   p = malloc(8*n);
+   if (p == NULL) err("no memory for SOH output");
+   for(j=0; j<n; j++) pdw(p+8*j, sohc.tim[j]);
+   if (1 != fwrite(p, 8*n, 1, sohd.fd)) goto wrerr;
+   for(j=0; j<n; j++) pfw(p+4*j, sohc.lat[j]);
+   if (1 != fwrite(p, 4*n, 1, sohd.fd)) goto wrerr;
+   for(j=0; j<n; j++) pfw(p+4*j, sohc.lon[j]);
+   if (1 != fwrite(p, 4*n, 1, sohd.fd)) goto wrerr;
+   for(i=0; i<N_SOHFLD; i++) {
+      int siz = sohflds[i].dt == HW ? 2 : 4;
+      for(j=0; j<n; j++)
+         if (siz == 2) phw(p+2*j, sohc.val[i][j]); else pfw(p+4*j, sohc.val[i][j]);
+      if (1 != fwrite(p, siz*n, 1, sohd.fd)) goto wrerr;
+   }
+   free(p);
+   sohc.n = 0;
+   return;
+wrerr:
+   err("Error writing SOH output file");
+}
+
+/* Write a checkpoint:  everything written so far is flushed to disk, then
+   the restart position, output lengths and SOH buffer state are saved.
+   The checkpoint is written to a temporary file and renamed, so that a
+   crash leaves either the previous checkpoint or this one intact. */
+
+void wrckpt(char *store, int ix, off_t off){
+   char *tmp = malloc(strlen(ckfile)+5);
+   FILE *fd;
+   int i;
+
+   if (tmp == NULL) err("checkpoint error");
+   drain();
+   if (sohd.fd && soh_fmt == SOH_FMT_COL) sohcput();
+   for(i=0; i<=nstrm; i++) {
+      struct sstate *s = sst(i);
+      s->ckl = -1;
+      if (s->fd == NULL) continue;
+      if (fflush(s->fd) || fsync(fileno(s->fd)))
+         err("error flushing output file for checkpoint");
+      s->ckl = ftello(s->fd);
+   }
+   if (sds && sdsflush(sds)) err("error flushing SDS archive for checkpoint");
+   sprintf(tmp, "%s.tmp", ckfile);
+   fd = fopen(tmp, "w");
+   if (fd == NULL) err("can't write checkpoint file");
+   fprintf(fd, "tv3mseed checkpoint\nstore %s\nsection %d %lld\n",
+      store, ix, (long long)off);
+   fprintf(fd, "streams %d\n", nstrm);
+   for(i=0; i<nstrm; i++)
+      fprintf(fd, "stream %d %d %lld %s %s\n", strm[i].band, strm[i].blkno,
+         strm[i].ckl, strm[i].chid,
+	 strm[i].loc[0] == ' ' ? "--" : strm[i].loc);
+   fprintf(fd, "sohout %d %lld\n", sohd.blkno, sohd.ckl);
+   fprintf(fd, "soh %d %d %d %llu %d %llu\n", sohblk, sohcnt, sohdt,
+      (unsigned long long)sohtim, sohrdt, (unsigned long long)sohrt0);
+   fprintf(fd, "sohdts %d", nsohdt);
+   for(i=0; i<nsohdt; i++) fprintf(fd, " %d", sohdts[i]);
+   fprintf(fd, "\n");
+   for(i=0; i<sizeof(sohmsd); i++)
+      fprintf(fd, "%02x%s", sohmsd[i], i%32 == 31 ? "\n" : "");
+   if (fflush(fd) || fsync(fileno(fd)) || fclose(fd))
+      err("error writing checkpoint file");
+   if (rename(tmp, ckfile)) err("can't rename checkpoint file");
+   free(tmp);
+   if (verb) fprintf(msgs, "checkpoint at section %d offset %llx\n",
+      ix, (long long)off);
+}
+
+/* Read checkpoint, restoring the state saved in it */
+
+void rdckpt(char *store){
+   FILE *fd = fopen(ckfile, "r");
+   char name[4096], chid[4], loc[3];
+   long long off, len;
+   unsigned long long tim, tim0;
+   unsigned int b;
+   int i, j, n, band, blk;
+
+   if (fd == NULL) err("can't read -ckpt file");
+   if (3 != fscanf(fd, "tv3mseed checkpoint store %4095s section %d %lld",
+      name, &ck.ix, &off)) err("bad checkpoint file");
+   if (strcmp(name, store)) err("checkpoint is for a different store");
+   ck.off = off;
+   if (1 != fscanf(fd, " streams %d", &n)) err("bad checkpoint file");
+   for(i=0; i<n; i++) {
+      struct sstate *s;
+      if (5 != fscanf(fd, " stream %d %d %lld %3s %2s",
+         &band, &blk, &len, chid, loc) || band < 0 || band > 255)
+	 err("bad checkpoint file");
+      j = getstrm(band);
+      s = strm+j;
+      s->blkno = blk; s->ckl = len;
+      if (!s->named) {
+         strcpy(s->chid, chid);
+	 strcpy(s->loc, strcmp(loc, "--") ? loc : "  ");
+	 s->named = 1;
+      }
+   }
+   if (2 != fscanf(fd, " sohout %d %lld", &sohd.blkno, &sohd.ckl))
+      err("bad checkpoint file");
+   if (6 != fscanf(fd, " soh %d %d %d %llu %d %llu", &sohblk, &sohcnt,
+      &sohdt, &tim, &sohrdt, &tim0)) err("bad checkpoint file");
+   sohtim = tim; sohrt0 = tim0;
+   if (1 != fscanf(fd, " sohdts %d", &nsohdt) || nsohdt < 0
+    || nsohdt > NSOHDT) err("bad checkpoint file");
+   for(i=0; i<nsohdt; i++)
+      if (1 != fscanf(fd, " %d", sohdts+i)) err("bad checkpoint file");
+   for(i=0; i<sizeof(sohmsd); i++) {
+      if (1 != fscanf(fd, " %2x", &b)) err("bad checkpoint file");
+      sohmsd[i] = b;
+   }
+   fclose(fd);
+   if (verb) fprintf(msgs, "resuming at section %d offset %llx\n",
+      ck.ix, (long long)ck.off);
+}
+
+/* Close output files, flushing anything held back */
+
+void clsout(){
+   int i, j;
+
+   for(i=0; i<=nstrm; i++) {
+      if (sst(i)->fd == NULL) continue;
+      for(j=0; j<i && sst(j)->fd != sst(i)->fd; j++);
+      if (j < i) continue;
+      if (fclose(sst(i)->fd)) err("error closing output file");
+   }
+}
+
+/* Read time windows file */
+
+int cmpwin(const void *a, const void *b){
+   const struct win *x = a, *y = b;
+   return (x->t0 > y->t0) - (x->t0 < y->t0);
+}
+
+void readwin(char *file){
+   FILE *fd = fopen(file, "r");
+   char line[256], ts[64], te[64];
+   int64_t t0, t1;
+   int i, j, mwin = 0;
+
+   if (fd == NULL) err("bad -w file name");
+   while (fgets(line, sizeof(line), fd)) {
+      if (line[0] == '#') continue;
+      if (2 != sscanf(line, "%63s %63s", ts, te)) continue;
+      if (mstime(ts, &t0) || mstime(te, &t1) || t1 <= t0) {
+         fprintf(stderr, "%s: bad -w window (ignored): %s", prog, line);
+	 continue;
+      }
+      if (nwin >= mwin) {
+         mwin = mwin ? 2*mwin : 64;
+	 wins = realloc(wins, mwin*sizeof(struct win));
+	 if (wins == NULL) err("window table error");
+      }
+      wins[nwin].t0 = t0; wins[nwin].t1 = t1; nwin += 1;
+   }
+   fclose(fd);
+   if (nwin == 0) err("no windows in -w file");
+
+   /* Sort and merge overlapping windows; lookup is then a binary search */
+   qsort(wins, nwin, sizeof(struct win), cmpwin);
+   for(i=0, j=1; j<nwin; j++) {
+      if (wins[j].t0 <= wins[i].t1) {
+         if (wins[j].t1 > wins[i].t1) wins[i].t1 = wins[j].t1;
+      } else
+         wins[++i] = wins[j];
+   }
+   nwin = i+1;
+   if (verb) fprintf(msgs, "%d time windows after merging\n", nwin);
+}
+
+/* Check whether time span [t0, t1) (or instant t0 if t1 == t0) overlaps any
+   window */
+
+int inwin(uint64_t t0, uint64_t t1){
+   int lo = 0, hi = nwin, mid;
+   if (t1 > t0) t1 -= 1;
+   /* Find first window starting after t1 */
+   while (lo < hi) {
+      mid = (lo+hi)/2;
+      if (wins[mid].t0 <= t1) lo = mid+1; else hi = mid;
+   }
+   return lo > 0 && wins[lo-1].t1 > t0;
+}
+
+/* SOH sample interval (s) from recent intervals, 0 if none yet */
+
+int sohest(){
+   int d[NSOHDT], i, j, t;
+
+   if (sohdt > 0) return sohdt;
+   if (nsohdt == 0) return 0;
+   for(i=0; i<nsohdt; i++) {       /* Insertion sort; there are few */
+      t = sohdts[i];
+      for(j=i; j>0 && d[j-1] > t; j--) d[j] = d[j-1];
+      d[j] = t;
+   }
+   t = (d[nsohdt/2] + 500)/1000;
+   return t > 0 ? t : 1;
+}
+
+/* Write SOH MSEED record being built */
+
+void sohput(){
+   int dt = sohrdt ? sohrdt : sohest();
+
+   phw(sohmsd+30, sohcnt);                       /* count */
+   phw(sohmsd+32, -(dt ? dt : SOHDEF));          /* SRF */
+   if (1 != fwrite(sohmsd, sizeof(sohmsd), 1, sohd.fd))
+      errcnt(sohblk, "Error writing SOH output file");
+   sohcnt = 0;
+}
+
 void bufsoh(
    char code[5], uint64_t ptim, struct sloc loc, int buflen, unsigned char buf[]
 ){
-   size_t off = 0;
+   static char csvhdr = 0;
    struct timeval tv;
    struct tm *tm;
-   enum {XX, LL = 11, HW = 1, FW = 3, FL = 4} any = XX; /* Bkette 1000 codes */
-   int ifw;
-   short ihw;
-   float ifl;
+   enum soh_type any = XX;
+   int val[N_SOHFLD], have, i;
+   int ifw = 0;
+   short ihw = 0;
+   float ifl = 0;
 
    /* Decode time */
    tv.tv_sec = ptim/1000000000l;
    tv.tv_usec = (ptim%1000000000l)/1000;
    tm = gmtime(&tv.tv_sec);
 
-   /* Parse buffer to find interesting bit */
-   while (off < buflen) {
-      short siz = hw(buf+off) & 0x1fff, type = hw(buf+off+2);
-      union { unsigned int fw; float fl; } u;
-      switch (type) {
-      case 0x0127:    /* Environmental */
-         if (soh_itm == SOH_TEMP) {
-	    u.fw = fw(buf+off+7); any=FL; ifl = u.fl;
+   have = sohdec(buflen, buf, val);
+
+   switch (soh_fmt) {              /* All fields, one row per packet */
+   case SOH_FMT_CSV:
+      if (!csvhdr && !(resume && sohd.ckl > 0)) {
+         fprintf(sohd.fd, "time,lat,lon");
+	 for(i=0; i<N_SOHFLD; i++) fprintf(sohd.fd, ",%s", sohflds[i].name);
+	 fprintf(sohd.fd, "\n");
+      }
+      csvhdr = 1;
+      fprintf(sohd.fd, "%04d/%02d/%02d %02d:%02d:%02d.%03d,%f,%f",
+	 1900+tm->tm_year, 1+tm->tm_mon, tm->tm_mday,
+	 tm->tm_hour, tm->tm_min, tm->tm_sec, (int)tv.tv_usec/1000,
+	 1e-6*loc.lat, 1e-6*loc.lon);
+      for(i=0; i<N_SOHFLD; i++) {
+	 union { unsigned int fw; float fl; } u;
+         if (!(have & 1<<i))
+	    fprintf(sohd.fd, ",");
+	 else if (sohflds[i].dt == HW)
+	    fprintf(sohd.fd, ",%d", val[i]);
+	 else {
+	    u.fw = val[i]; fprintf(sohd.fd, ",%f", u.fl);
 	 }
-         break;
-      case 0x0192:    /* Sensor SOH */
-         if (soh_itm == SOH_MASS1_V) u.fw = fw(buf+off+ 9), any=FL;
-         if (soh_itm == SOH_MASS2_V) u.fw = fw(buf+off+18), any=FL;
-         if (soh_itm == SOH_MASS3_V) u.fw = fw(buf+off+27), any=FL;
-	 if (any==FL) ifl = u.fl;
-	 break;
-      case 0x012b:    /* Environmental */
-         if (soh_itm == SOH_SUPPLY_V) {
-	    ihw = hw(buf+19); any=HW;
+      }
+      fprintf(sohd.fd, "\n");
+      return;
+   case SOH_FMT_COL:
+      if (sohc.n == 0)             /* Station and network for block */
+	 for(i=0; i<5; i++) {
+            sohmsd[8+i] = (snam[0] == ' ' ? code[i] : snam[i]);
+	    if (i < 2) sohmsd[18+i] = snet[i];
+	 }
+      sohc.tim[sohc.n] = ptim;
+      sohc.lat[sohc.n] = loc.lat; sohc.lon[sohc.n] = loc.lon;
+      for(i=0; i<N_SOHFLD; i++)
+         sohc.val[i][sohc.n] = (have & 1<<i) ? val[i] :
+	    sohflds[i].dt == HW ? -32768 : 0x7fc00000;
+      if (++sohc.n == SOHCBLK) sohcput();
+      return;
+   default:                        /* Just the -item asked for */
+      for(i=0; i<N_SOHFLD; i++) {
+         union { unsigned int fw; float fl; } u;
+         if (sohflds[i].itm != soh_itm || !(have & 1<<i)) continue;
+	 any = sohflds[i].dt;
+	 if (any == HW) ihw = val[i];
+	 else {
+	    ifw = val[i]; u.fw = val[i]; ifl = u.fl;
 	 }
-	 break;
       }
-      off += siz;
    }
    if (any == XX && soh_itm == SOH_POS) any = LL;
    if (any != XX){
       short itmsiz;
-      int dtnow;
-      double dtms;
       switch (soh_fmt){
+      default:
       case SOH_FMT_TEXT:
 	 fprintf(sohd.fd, "%04d/%02d/%02d %02d:%02d:%02d.%03d ",
 	    1900+tm->tm_year, 1+tm->tm_mon, tm->tm_mday,
@@ -274,38 +1181,55 @@ void bufsoh(
 	 break;
       case SOH_FMT_MSEED:
          itmsiz = (any == HW) ? 2 : 4;
-	 dtms = (ptim - sohtim)/1000000;
-	 dtnow = 1e-3*dtms;
-         if (sohcnt > 1) {
-	    /* SOH sample rate is usually long, from 5 s to 3600 s.
-	       If this is exceeded by 2.5 s, then declare a time discontinuity
-               and dump the data accumulated so far.
-	    */
-	    int writ = 0;
-	    float chk = fabs(sohdt-1e-3*((ptim - sohtim)/1000000));
-	    if (dtnow>0 && abs(sohdt-dtnow) >= sohdt/6) {
-	       if (verb) printf("New SOH dt at "
+         if (sohcnt > 0) {
+	    /* Keep interval between packets for the estimate, then see
+	       whether this packet is on the record's time grid.  If it is
+	       off by more than a quarter interval there is a gap; write the
+	       record and start another. */
+	    int64_t dtms = ((int64_t)ptim - (int64_t)sohtim)/1000000;
+	    double off;
+	    int d0, d1;
+	    if (dtms > 0 && dtms < INT32_MAX) {
+	       if (nsohdt == NSOHDT)
+	          memmove(sohdts, sohdts+1, (NSOHDT-1)*sizeof(int));
+	       else
+	          nsohdt += 1;
+	       sohdts[nsohdt-1] = dtms;
+	    }
+	    if (sohrdt == 0) sohrdt = sohest(); /* Very first interval */
+	    off = 1e-9*((int64_t)ptim - (int64_t)sohrt0) - (double)sohcnt*sohrdt;
+	    d0 = nsohdt > 1 ? sohdts[nsohdt-2] : 0;
+	    d1 = nsohdt > 0 ? sohdts[nsohdt-1] : 0;
+	    if (sohcnt == 1 && sohdt == 0 && d0 > 0 && fabs(off) > sohrdt/4.0
+	     && abs(d1 - d0) <= d1/4) {
+	       /* Interval changed:  two alike in a row that don't fit the
+	          estimate.  Record takes the new interval before the median
+		  catches up. */
+	       d1 = (d1+500)/1000; if (d1 < 1) d1 = 1;
+	       if (verb) fprintf(msgs, "New SOH dt at "
 	             "%04d/%02d/%02d %02d:%02d:%02d.%03d: %d -> %d\n",
 		     1900+tm->tm_year, 1+tm->tm_mon, tm->tm_mday,
-		     tm->tm_hour, tm->tm_min, tm->tm_sec, tv.tv_usec/1000,
-		     sohdt,dtnow);
+		     tm->tm_hour, tm->tm_min, tm->tm_sec, (int)tv.tv_usec/1000,
+		     sohrdt, d1);
+	       sohrdt = d1;
+	       off = 1e-9*((int64_t)ptim - (int64_t)sohrt0) - sohrdt;
 	    }
-	    /* Check if time discontinuity, dump blockette if so */
-	    if (chk > sohdt/6 /* && sohcnt>20 */) writ = 1;
-	    if (sohcnt*itmsiz >= sizeof(sohmsd)-64) writ = 1;
-	    if (writ) {
-	       phw(sohmsd+30, sohcnt); phw(sohmsd+32, -sohdt); /* count, SRF */
-	       writ = fwrite(sohmsd, sizeof(sohmsd), 1, sohd.fd);
-	       if (writ < 1)
-	          errcnt(sohblk, "Error writing SOH output file");
-	       sohcnt = 0;
+	    if (sohdt == 0 && fabs(off) > sohrdt/4.0 && (d1 = sohest()) != sohrdt
+	     && fabs(1e-9*((int64_t)ptim - (int64_t)sohrt0) - (double)sohcnt*d1)
+	        <= d1/4.0) {
+	       /* Record's interval was a poor guess (few intervals seen yet);
+	          the better estimate fits, so keep going with it. */
+	       sohrdt = d1; off = 0;
 	    }
+	    if (fabs(off) > sohrdt/4.0 || (sohcnt+1)*itmsiz > sizeof(sohmsd)-64)
+	       sohput();
 	 }
          if (sohcnt == 0) {
 	    /* Start of new buffer.  Build up MSEED header and type 1000
 	       blockette */
 	    int i;
 	    sohblk += 1;
+	    sohrt0 = ptim; sohrdt = sohest();
 	    snprintf((char*)sohmsd, 7, "%06d", sohblk);     /* Block # 0-5 */
 	    sohmsd[6] = 'D'; sohmsd[7] = ' ';        /* D flag  6-7   */
             for(i=0;i<5;i++)                         /* Station code 8-12 */
@@ -356,13 +1280,46 @@ void bufsoh(
    }
 }
 
+/* Make a stream's MSEED header template:  everything but the sequence
+   number, time, sample count and rate, filled in once for all the stream's
+   blockettes.  The station code comes from the Taurus serial number unless
+   given with -S. */
+
+void mkhdr(struct sstate *state, char code[5]){
+   unsigned char *bkhdr = state->hdr;
+   int i;
+
+   memset(bkhdr, 0, sizeof(state->hdr));
+   memset(bkhdr, '0', 6);
+   bkhdr[6] = 'D'; bkhdr[7] = ' ';
+   for(i=0;i<5;i++) bkhdr[8+i] = (snam[0] == ' ' ? code[i] : snam[i]);
+   bkhdr[13] = state->loc[0]; bkhdr[14] = state->loc[1];
+   for(i=0;i<3;i++) bkhdr[15+i] = state->chid[i];
+   bkhdr[18] = snet[0]; bkhdr[19] = snet[1];
+   bkhdr[36] = 0;   /* Activity flags: 0 */
+   bkhdr[37] = 0;   /* I/O & Clock quality: 0 */
+   bkhdr[38] = 0;   /* Data quality: 0 */
+   bkhdr[39] = 1;   /* Number of data blockettes following */
+   pfw(bkhdr+40,      0);   /* Time correction */
+   phw(bkhdr+44,     64);   /* Data offset */
+   phw(bkhdr+46,     48);   /* Data blockette offset */
+
+   phw(bkhdr+48+0, 1000);   /* Type 1000 data blockette */
+   phw(bkhdr+48+2,    0);   /* Next 0 */
+   bkhdr[48+4] = 10;/* Encoding format: Steim I */
+   bkhdr[48+5] = 1; /* Word order: big-endian */
+   bkhdr[48+6] = 9; /* Record length: 2**9 (512) */
+   bkhdr[48+7] = 0; /* Reserved byte zeroed */
+   state->hset = 1;
+}
+
 void bufdat(
    int ix, char code[5], uint64_t ptim,
    int buflen, unsigned char buf[]
 ){
    int ndat = hw(buf+6);
    int i, j, lim, srf = buf[4], srm = buf[5];
-   unsigned char bkhdr[64], data[512];
+   unsigned char blk[512], *bkhdr, *data;
    struct sstate *state = strm+ix;
    struct timeval tv;
    struct tm *tm;
@@ -372,69 +1329,173 @@ void bufdat(
    tv.tv_usec = (ptim%1000000000l)/1000;
    tm = gmtime(&tv.tv_sec);
 
-   /* Build blockette header */
-   snprintf((char*)bkhdr+0, 7, "%06d", state->blkno%1000000);
-   bkhdr[6] = 'D'; bkhdr[7] = ' ';
-   for(i=0;i<5;i++) bkhdr[8+i] = code[i];
-   bkhdr[13] = ' '; bkhdr[14] = ' ';
-   for(i=0;i<3;i++) bkhdr[15+i] = state->chid[i];
-   bkhdr[18] = 'Y'; bkhdr[19] = 'Y';
+   /* Blockette header from stream's template, then the parts that change.
+      With -pipe, the blockette is made in the writer's ring. */
+   if (!state->hset || (snam[0] == ' ' && memcmp(state->hdr+8, code, 5)))
+      mkhdr(state, code);
+   bkhdr = state->wr ? rngput(state->wr, sizeof(blk)) : blk;
+   data = bkhdr + sizeof(state->hdr);
+   memcpy(bkhdr, state->hdr, sizeof(state->hdr));
+   for(i=5, j=state->blkno%1000000; i>=0; i--, j/=10) bkhdr[i] = '0' + j%10;
    phw(bkhdr+20, tm->tm_year+1900);
    phw(bkhdr+22, tm->tm_yday+1);
    bkhdr[24] = tm->tm_hour;
    bkhdr[25] = tm->tm_min;
    bkhdr[26] = tm->tm_sec;
-   bkhdr[27] = 0;
    phw(bkhdr+28,   tv.tv_usec/100);
    phw(bkhdr+30,   ndat);
    phw(bkhdr+32,    srf);
    phw(bkhdr+34,    srm);
-   bkhdr[36] = 0;   /* Activity flags: 0 */
-   bkhdr[37] = 0;   /* I/O & Clock quality: 0 */
-   bkhdr[38] = 0;   /* Data quality: 0 */
-   bkhdr[39] = 1;   /* Number of data blockettes following */
-   pfw(bkhdr+40,      0);   /* Time correction */
-   phw(bkhdr+44,     64);   /* Data offset */
-   phw(bkhdr+46,     48);   /* Data blockette offset */
-   for(i=48;i<sizeof(bkhdr);i++) bkhdr[i] = 0;
    if (lpsc) {
       /* Check if leap second in this blockette and flag if so */
       double dt = difftime(lptm, tv.tv_sec) - 1e-6*tv.tv_usec;
-      double sr;
-      sr = (srf>0 && srm>0) ?  srf*srm :
-           (srf>0 && srm<0) ? -srf/srm :
-           (srf<0 && srm>0) ? -srm/srf : 1/(srf*srm);
+      double sr = srate(srf, srm);
       if (dt > 0 && dt <= ndat/sr) {
          bkhdr[36] |= lpsc;
-	 if (verb) printf("%s: leap second straddle %s block %d\n",
+	 if (verb) fprintf(msgs, "%s: leap second straddle %s block %d\n",
 	    prog, state->chid, state->blkno);
       }
    }
 
-   phw(bkhdr+48+0, 1000);   /* Type 1000 data blockette */
-   phw(bkhdr+48+2,    0);   /* Next 0 */
-   bkhdr[48+4] = 10;/* Encoding format: Steim I */
-   bkhdr[48+5] = 1; /* Word order: big-endian */
-   bkhdr[48+6] = 9; /* Record length: 2**9 (512) */
-   bkhdr[48+7] = 0; /* Reserved byte zeroed */
-
-   /* Write header */
-   i = fwrite(bkhdr, sizeof(bkhdr), 1, state->fd);
-   if (i != 1) errcnt(state->blkno, "Error writing blockette (hdr)");
-
-   j = buflen-8; lim = sizeof(data)-sizeof(bkhdr);
+   j = buflen-8; lim = sizeof(blk)-sizeof(state->hdr);
    if (j > lim) {
       fprintf(stderr, "%s: %s data block %d > 512 (len is %d); truncated\n",
          prog, state->chid, state->blkno, j);
       j = lim;
    }
    for(i=0; i<j; i++) data[i] = buf[8+i]; for(;i<lim; i++) data[i] = 0;
-   i = fwrite(data, lim, 1, state->fd);
-   if (i != 1) errcnt(state->blkno, "Error writing blockette (data)");
+
+   /* Write blockette, or hand it to the writer thread or the archive */
+   if (state->wr)
+      rngpost(state->wr, sizeof(blk));
+   else if (state->fd == NULL) {
+      if (sdsput(sds, bkhdr, sizeof(blk)))
+         errcnt(state->blkno, "Error writing blockette to SDS archive");
+   } else {
+      i = fwrite(bkhdr, sizeof(blk), 1, state->fd);
+      if (i != 1) errcnt(state->blkno, "Error writing blockette");
+   }
 
    state->blkno += 1;
 }
 
+/* Stream's station, location and channel codes for -tears lines */
+
+void tearid(struct sstate *s, char code[5], char *str){
+   int i;
+
+   for(i=0; i<5 && (snam[0] == ' ' ? code[i] : snam[i]) != ' '; i++)
+      str[i] = snam[0] == ' ' ? code[i] : snam[i];
+   sprintf(str+i, " %s %s", s->loc[0] == ' ' ? "--" : s->loc, s->chid);
+}
+
+/* Time in -tears lines */
+
+void teartim(int64_t tns, char *str){
+   msfmt(tns, str);
+   str[10] = 'T';
+}
+
+/* Compare a data packet's time with the time predicted from the stream's
+   last packet, reporting jumps of more than half a sample and changes in
+   clock status.
+   Under -tearfix, a tear of a second against the leap second after it,
+   or with it before it, marks the span of mistimed data. */
+
+void tearchk(int ix, char code[5], uint64_t ptim, int clk, unsigned char pay[]){
+   static char *cstat[] = {"none", "incorrect", "unlocked", "locked"};
+   struct sstate *s = strm+ix;
+   double sr = srate(pay[4], pay[5]);
+   char id[16], tstr[32];
+
+   if (sr <= 0) return;
+   if (s->tnext && ptim != s->tnext) {
+      int64_t d = (int64_t)(ptim - s->tnext), n, tol = 0.5e9/sr;
+      n = (d + (d < 0 ? -SEC/2 : SEC/2))/SEC;
+      if (tearfd && llabs(d) > tol) {
+	 tearid(s, code, id); teartim(ptim, tstr);
+	 fprintf(tearfd, "tear %s %s %.4f\n", id, tstr, 1e-9*d);
+      }
+      if (n != 0 && llabs(d - n*SEC) <= tol) {
+	 if (tfix && (n == 1 || n == -1)) {
+	    int dir = lpsc == 0x10 ? 1 : -1;
+	    int64_t leap = (int64_t)lptm*SEC;
+	    if (n == -dir && ptim > leap && s->tr1 == 0)
+	       s->tr0 = leap, s->tr1 = ptim;
+	    else if (n == dir && ptim < leap && ptim > leap - 183*86400*SEC)
+	       s->tr0 = ptim, s->tr1 = leap;
+	 }
+      }
+   }
+   if (tearfd && s->tnext && ((clk ^ s->clk) & 0x0c)) {
+      tearid(s, code, id); teartim(ptim, tstr);
+      fprintf(tearfd, "clock %s %s %s %s\n", id, tstr,
+         cstat[s->clk>>2 & 3], cstat[clk>>2 & 3]);
+   }
+   s->clk = clk;
+   s->tnext = ptim + (uint64_t)(1e9*hw(pay+6)/sr + 0.5);
+}
+
+/* Correct the times of the records of streams mistimed by a leap second
+   (-tearfix), rewriting the headers of the records in the output files */
+
+void tearfix(){
+   unsigned char rec[64];
+   int dir = lpsc == 0x10 ? 1 : -1;
+   int64_t leap = (int64_t)lptm*SEC;
+   int i, j, k;
+
+   for(i=0; i<nstrm; i++) {
+      struct sstate *s = strm+i;
+      struct mshdr h;
+      off_t off;
+      int fd;
+      if (s->fd == NULL || s->tr1 == 0) continue;
+      for(j=0; j<i && (strm[j].fd != s->fd || strm[j].tr1 == 0); j++);
+      if (j < i) continue;         /* File done with an earlier stream */
+      if (fflush(s->fd)) err("error writing output file");
+      fd = open(s->fn, O_RDWR);
+      if (fd < 0) err("can't reopen output file for -tearfix");
+      for(off=0; sizeof(rec) == pread(fd, rec, sizeof(rec), off); off+=512) {
+	 int64_t tns;
+	 unsigned char aflg;
+         if (msdec(rec, &h)) continue;
+	 for(k=0; k<nstrm; k++) {
+	    struct sstate *t = strm+k;
+	    if (t->fd == s->fd && t->tr1 && 0 == memcmp(rec+15, t->chid, 3)
+	     && 0 == memcmp(rec+13, t->loc, 2)) break;
+	 }
+	 if (k == nstrm) continue;
+	 tns = h.tns;
+	 if (tns >= strm[k].tr0 && tns < strm[k].tr1) {
+	    tns -= dir*SEC;
+	    msput(rec, &h, tns);
+	    if (dir > 0 && tns >= leap-SEC && tns < leap) rec[26] = 60;
+	    strm[k].nfix += 1;
+	 }
+	 aflg = rec[36] & ~0x30;   /* Leap second now in record? */
+	 if (tns <= leap && tns + (msend(&h) - h.tns) >= leap) aflg |= lpsc;
+	 if (tns != h.tns || aflg != rec[36]) {
+	    rec[36] = aflg;
+	    if (sizeof(rec) != pwrite(fd, rec, sizeof(rec), off))
+	       err("error rewriting output file for -tearfix");
+	 }
+      }
+      if (close(fd)) err("error rewriting output file for -tearfix");
+      for(k=0; k<nstrm; k++) {
+	 struct sstate *t = strm+k;
+	 char id[16], t0[32], t1[32];
+	 if (t->fd != s->fd || t->tr1 == 0) continue;
+	 tearid(t, (char *)t->hdr+8, id);
+	 teartim(t->tr0, t0); teartim(t->tr1, t1);
+	 if (tearfd) fprintf(tearfd, "fix %s %s %s %d %lld\n", id, t0, t1, -dir,
+	    t->nfix);
+	 if (verb) fprintf(msgs, "%s: %s %lld records from %s to %s moved "
+	    "%d s\n", prog, t->chid, t->nfix, t0, t1, -dir);
+      }
+   }
+}
+
 /* Process packet */
 
 void dhdr(off_t off, size_t siz, unsigned char buf[]){
@@ -446,6 +1507,8 @@ void dhdr(off_t off, size_t siz, unsigned char buf[]){
               *Not sure that seq = 2 is relevant or guaranteed.
        71   25   7*  0
               *Not sure that seq = 7 is relevant or guaranteed.
+      Other bands (a second sensor, high rate channels) are taken to be data
+      if their payload is 01 c8.
 
        As of July 2012, Flags that report clock status are never set and
        not used in the decoding.
@@ -456,6 +1519,7 @@ void dhdr(off_t off, size_t siz, unsigned char buf[]){
    char id[6];
    if (buf[0] != 'n' || buf[1] != 'p') erroff(off, "bad packet header");
    band = buf[27];
+   st.band[band] += 1;
    if ((buf[2]>>5) == 3)
       extoff = 29+8+2;
    else if ((buf[2]>>5) == 2)
@@ -490,29 +1554,51 @@ void dhdr(off_t off, size_t siz, unsigned char buf[]){
 	    prog, (size_t)off, buf[29]);
       break;
    default:
-      return;
+      datoff = extoff + ((buf[2] & 0x80) ? 1+buf[extoff] : 0);
+      if (buf[datoff] != 0x01 || buf[datoff+1] != 0xc8) {
+         st.skip += 1;
+         return;
+      }
+      extoff = datoff;
+      break;
    }
    datlen = siz-extoff;             /* Length of data in packet */
    datoff = extoff;
    pkttim = dw(buf+8);
+   if (nwin) {
+      /* Skip packet unless the time span of its data is in a window */
+      uint64_t pktend = pkttim;
+      if (band != 71 && buf[datoff+4] && buf[datoff+5])
+         pktend += 1e9*hw(buf+datoff+6)/srate(buf[datoff+4], buf[datoff+5]);
+      if (!inwin(pkttim, pktend)) {st.skip += 1; return;}
+   }
    iid = hw(buf+25) & 0xffff;       /* Turn s/n into station name */
    snprintf(id, 6, "%05d", iid%10000); id[0] = "0123456789ABCDEF"[iid/10000];
    switch (band) {
-   case 65: case 67: case 69:
-      datix = (band-65)>>1;            /* Turn into index 0 = Z, 1 = N, 2 = E */
-      if (NULL == strm[datix].fd) {
+   default:
+      datix = bndix[band] ? bndix[band]-1 : newstrm(band, buf+datoff);
+      if (NULL == strm[datix].fd && NULL == sds) {
+         st.skip += 1;
          if (strm[datix].msg) {
             fprintf(stderr, "%s: %s data skipped (output file not assigned)\n",
                prog, strm[datix].chid);
 	    strm[datix].msg = 0;
 	 }
-      } else
+      } else {
+         double t = stats ? now() : 0;
+	 if (tearfd || tfix) tearchk(datix, id, pkttim, buf[7], buf+datoff);
 	 bufdat(datix, id, pkttim, datlen, buf+datoff); /* Process buffer */
+	 if (stats) st.twrt += now() - t;
+      }
       break;
    case 71:
       loc.lat = fw(buf+16); loc.lon = fw(buf+20);
-      if (sohd.fd)
+      if (sohd.fd) {
+         double t = stats ? now() : 0;
          bufsoh(id, pkttim, loc, datlen, buf+datoff);  /* Process buffer */
+	 if (stats) st.twrt += now() - t;
+      } else
+         st.skip += 1;
       break;
    }
 }
@@ -540,6 +1626,90 @@ int cktype(char buf[]){
    return 1;
 }
 
+/* Packet size, from header */
+
+size_t pktsiz(char buf[]){
+   size_t siz = hw((unsigned char*)buf+2) & 0x1fff; /* Mask high bit flags */
+   if ((buf[2]>>5 & 0x03) == 3) siz |= hw((unsigned char*)buf+29+8) << 13;
+   if ((buf[2]>>5 & 0x03) == 2) siz |= hw((unsigned char*)buf+29+1) << 13;
+   return siz;
+}
+
+/* Check whether buffer holds a plausible packet header:  right type, sane
+   size, and time near that of the last good packet (if any) */
+
+uint64_t lsttim = 0;
+
+int ckpkt(char buf[]){
+   size_t siz;
+   uint64_t t;
+
+   if (!cktype(buf)) return 0;
+   siz = pktsiz(buf);
+   if (siz < PKTMIN || siz > PKTMAX) return 0;
+   t = dw((unsigned char*)buf+8);
+   if (lsttim)
+      return (t > lsttim ? t - lsttim : lsttim - t) < RSYNDT;
+   return t > 946684800000000000ULL && t < 4102444800000000000ULL;
+}
+
+/* Scan store forward from a damaged packet at off for the next plausible
+   packet header or end of cluster marker, before offset end.  Packets are
+   word-aligned relative to the cluster start, base.  Reports the bytes
+   skipped and returns the offset found, or -1 if there is none. */
+
+off_t resync(FILE *fd, off_t off, off_t base, off_t end, char *why){
+   static char sbuf[RSYNBUF+40];
+   off_t pos = off+1, fnd = -1;
+   size_t n, lim;
+   char *p, *e;
+
+   pos += (4 - ((pos-base) & 3)) & 3;
+   while (fnd < 0 && pos < end) {
+      if (fseeko(fd, pos, SEEK_SET)) break;
+      n = fread(sbuf, 1, sizeof(sbuf), fd);
+      if (n < 8) break;
+      lim = n > RSYNBUF ? RSYNBUF : n;
+      if (pos + lim > end) lim = end - pos;
+      /* First end marker in chunk bounds the search for a packet */
+      for(e = sbuf; (e = memmem(e, n-(e-sbuf), "ENDODATA", 8)); e++)
+         if (((pos + (e-sbuf) - base) & 3) == 0) break;
+      if (e && e-sbuf < lim) lim = e-sbuf;
+      for(p = sbuf; (p = memchr(p, 'n', lim-(p-sbuf))); p++) {
+         if (((pos + (p-sbuf) - base) & 3) || p+40 > sbuf+n) continue;
+	 if (ckpkt(p)) break;
+      }
+      if (p)
+         fnd = pos + (p-sbuf);
+      else if (e && e-sbuf == lim)
+         fnd = pos + lim;
+      else
+         pos += lim;
+   }
+   st.nrsyn += 1;
+   st.lost += (fnd < 0 ? end : fnd) - off;
+   if (fnd < 0)
+      fprintf(stderr, "%s: at offset %llx, %s; rest of cluster skipped\n",
+         prog, (long long)off, why);
+   else
+      fprintf(stderr, "%s: at offset %llx, %s; skipped %lld bytes to %llx\n",
+         prog, (long long)off, why, (long long)(fnd-off), (long long)fnd);
+   fflush(stderr);
+   if (fnd >= 0 && fseeko(fd, fnd, SEEK_SET)) fnd = -1;
+   return fnd;
+}
+
+/* Open a store file, or get its status, in the -img file system if there
+   is one */
+
+FILE *stopen(char *name){
+   return img ? e2open(img, name) : fopen(name, "r");
+}
+
+int ststat(char *name, struct stat *sb){
+   return img ? e2stat(img, name, sb) : stat(name, sb);
+}
+
 /* Return size of file minus size of volume header */
 
 size_t fsize(FILE *fd){
@@ -556,17 +1726,427 @@ struct aloc_t {
    size_t siz;
    int fnum;
 } *aloc;
+int naloc;
 
-int main(int argc, char *argv[]){
+/* Decode a packet read from the store; next is the offset of the one
+   after it, where extraction would restart from a checkpoint */
+
+uint64_t ckbytes = CKPTSIZ;
+
+void dopkt(char *store, int ix, off_t off, size_t siz, unsigned char buf[],
+   off_t next
+){
+   double t = stats ? now() : 0;
+
+   st.bytes += siz;
+   dhdr(off, siz, buf);
+   if (stats) {
+      st.tdec += now() - t;
+      if (strep) {stprt(); strep = 0;}
+   }
+   if (ckfile && st.bytes >= ckbytes) {
+      wrckpt(store, ix, next); ckbytes = st.bytes + CKPTSIZ;
+   }
+}
+
+/* Read each part of the allocation table, passing on the packets in its
+   clusters.  Run as a thread with -pipe, when it puts the packets in the
+   packet ring for the decoding thread. */
+
+void *rdstore(void *arg){
+   static char buf[PKTBUF];
+   char *store = arg, ok = 1;
+   int i, fno = 1, six = strstr(store, "001.store") - store;
+   off_t off, next;
+   size_t siz;
+   FILE *fd = stopen(store);
+
+   if (fd == NULL) err("bad store file name");
+   for(i=ck.ix; i<naloc; i++){
+      if (verb>1) fprintf(msgs, "alloc tbl walk: %d fno %d off %zx: ",
+         i, aloc[i].fnum, (size_t)aloc[i].off);
+      if (fno != aloc[i].fnum) {
+         char *tmp = strdup(store);
+         fno = aloc[i].fnum;
+	 sprintf(tmp+six, "%03d.store", fno);
+	 fclose(fd);
+	 fd = stopen(tmp);
+         if (fd == NULL) err("bad store file name");
+	 free(tmp);
+      }
+      off = fseeko(fd, aloc[i].off, SEEK_SET);
+
+      siz = fread(buf, 68, 1, fd);
+
+      if (follow && i == naloc-1 && (siz != 1 || strncmp(buf+36, "CLUS", 4))
+       && strncmp(buf+36, "CHTB", 4) && strncmp(buf+36, "CSTB", 4)) {
+         /* Last part of a growing store not written yet */
+	 ck.ix = i; ck.off = 0;
+	 goto front;
+      } else if (strncmp(buf+36, "CHTB", 4) == 0) {
+	 if (verb>1) fprintf(msgs, "CHTB: %zx, %zx\n", (size_t)off, aloc[i].siz);
+      } else if (strncmp(buf+36, "CSTB", 4) == 0) {
+	 if (verb>1) fprintf(msgs, "CSTB: %zx, %zx\n", (size_t)off, aloc[i].siz);
+      } else if (strncmp(buf+36, "CLUS", 4) == 0) {
+	 if (verb>1) fprintf(msgs, "CLUS: %zx, %zx (start %zx)\n",
+	    (size_t)off, aloc[i].siz, (size_t)aloc[i].off+68);
+         off = aloc[i].off+68;
+	 if (i == ck.ix && ck.off) {   /* Resuming in this section */
+	    off = ck.off;
+	    if (fseeko(fd, off, SEEK_SET)) erroff(off, "bad checkpoint seek");
+	 }
+	 do {
+	    double t = stats ? now() : 0;
+	    char *bad = NULL;
+	    int writ = fread(buf, 40, 1, fd);
+	    if (writ <= 0) {
+	       bad = "Zero read from store file";
+	    } else {
+	       if (ckend(buf)) break;
+	       if (!cktype(buf) || (rsyn && !ckpkt(buf)))
+	          bad = "packets not from V3 store";
+	    }
+	    if (bad == NULL) {
+	       siz = pktsiz(buf);
+	       if (siz > 40)
+	          writ = fread(buf+40, siz-40, 1, fd);
+	       if (writ <= 0)
+	          bad = "Incomplete data read from store file";
+	    }
+	    if (bad && follow && i == naloc-1) {
+	       /* End of what has been written of a growing store so far */
+	       if (verb) fprintf(msgs, "following: at offset %llx, %s\n",
+	          (long long)off, bad);
+	       ck.ix = i; ck.off = off;
+	       goto front;
+	    }
+	    if (bad) {
+	       if (!rsyn) erroff(off, bad);
+	       off = resync(fd, off, aloc[i].off+68, aloc[i].siz > 68 ?
+	          aloc[i].off+(off_t)aloc[i].siz : (off_t)INT64_MAX, bad);
+	       if (off < 0) break;
+	       continue;
+	    }
+	    lsttim = dw((unsigned char*)buf+8);
+	    if (stats) st.tio += now() - t;
+	    /* Seems to be necessary to round to word boundary */
+	    next = off + siz + ((0x03 & siz)?4-(0x03&siz):0);
+	    if (pipl) {
+	       struct pent e;
+	       unsigned char *p;
+	       e.len = (sizeof(e) + siz + 7) & ~(size_t)7;
+	       e.ix = i; e.off = off; e.next = next; e.siz = siz;
+	       p = rngput(&pkts, e.len);
+	       memcpy(p, &e, sizeof(e)); memcpy(p+sizeof(e), buf, siz);
+	       rngpost(&pkts, e.len);
+	    } else
+	       dopkt(store, i, off, siz, (unsigned char*)buf, next);
+	    off = next;
+	    writ = fseeko(fd, off, SEEK_SET);
+	    if (writ) erroff(off,"bad seek in cluster");
+	 } while(ok);
+      } else {
+        fprintf(stderr,"%-4.4s -- unrecognized\n", buf+36);
+	if (!rsyn) erroff(aloc[i].off,"unrecognized table section");
+	st.nrsyn += 1;
+      }
+   }
+
+   ck.ix = naloc; ck.off = 0;
+front:
+   fclose(fd);
+   atomic_store_explicit(&pkts.eof, 1, memory_order_release);
+   return NULL;
+}
+
+/* Read the allocation table, finding which store file each part is in.
+   Following a growing store, the table may list parts beyond the end of
+   the files so far; the table is taken to end there. */
+
+void rdtable(char *store){
    FILE *fd;
-   off_t off;
-   size_t siz, tmp, atsiz, fsiz, scum;
-   char ok = 1;
-   char *cbuf, *store = NULL;
+   size_t siz, tmp, fsiz, scum;
+   char *cbuf, buf[48];
    int i, six, fno, store_size;
-   char buf[0x100000];
+
+   /* Open store file */
+
+   fd = stopen(store);
+   if (fd == NULL) err("bad store file name");
+
+   /* Verify NMX volume, read allocation table */
+
+   siz = fread(buf, 48, 1, fd);
+
+   if(strncmp(buf, "NMXV", 4) != 0) err("not a NMX store");
+
+   if(strncmp(buf+32, "VOLFALOC", 8) != 0) err("missing allocation table");
+
+   /* Find store file number position */
+   cbuf = strstr(store, "001.store");
+   if(cbuf == NULL)
+      err("unusual store name (looking for 001.store suffix) -- correct?");
+   six = cbuf-store;
+
+   fsiz = fsize(fd);
+   scum = 0, fno = 1;
+   if (verb) fprintf(msgs, "store file %s size %zx\n", store, fsiz);
+
+   /* Decode table */
+   siz = fw((unsigned char*)buf+32+8); tmp = fw((unsigned char*)buf+32+12);
+   store_size = (int)siz;
+   free(aloc);
+   aloc = calloc(siz, sizeof(struct aloc_t));
+   if (aloc == NULL) err("allocation table error");
+   cbuf = malloc(tmp);
+   if (cbuf == NULL) err("table buffer error");
+   tmp = fread(cbuf, tmp-48, 1, fd);
+   for(i=0;i<siz;i++){
+      int j = i*16;
+      aloc[i].off = (off_t)dw((unsigned char*)cbuf+j+ 4) - scum;
+      aloc[i].siz = fw((unsigned char*)cbuf+j+12);
+//    printf("%d off %zx\n",i, (size_t)aloc[i].off);
+      if (aloc[i].off >= fsiz) {
+         char *tmp = strdup(store);
+         fno += 1; scum += fsiz;
+         aloc[i].off = (off_t)dw((unsigned char*)cbuf+j+ 4) - scum;
+	 sprintf(tmp+six, "%03d.store", fno);
+	 fclose(fd);
+	 fd = stopen(tmp);
+	 if (fd == NULL && follow) {  /* Not there yet */
+	    free(tmp);
+	    siz = i;
+	    break;
+	 }
+         if (fd == NULL) err("bad store file name");
+         fsiz = fsize(fd);
+	 if (verb) fprintf(msgs, "store file %s size %zx\n", tmp, fsiz);
+	 free(tmp);
+	 if (fsiz<=0) break;
+      }
+      aloc[i].fnum = fno;
+   }
+   free(cbuf);
+   if (verb) fprintf(msgs, "store size %d (%x)\n", store_size, store_size);
+   naloc = siz;
+   if (fd) fclose(fd);
+}
+
+/* Signature of the state of a store's files (sizes and times), to see
+   whether it has changed */
+
+uint64_t stsig(char *store){
+   char *name = strdup(store);
+   int six = strstr(store, "001.store") - store, fno;
+   uint64_t sig = 0;
+   struct stat sb;
+
+   if (name == NULL) err("out of memory");
+   for(fno=1; fno<1000; fno++) {
+      sprintf(name+six, "%03d.store", fno);
+      if (ststat(name, &sb)) break;
+      sig = 31*sig + sb.st_size + 17*sb.st_mtime;
+   }
+   free(name);
+   return sig;
+}
+
+/* Merging several stores (more than one <store> given):  a cursor on each
+   reads its clusters in time order, which need not be table order in a
+   store that has rolled over.  The packet with the earliest time at the
+   head of any cursor is taken next, so overlapping stores interleave into
+   one time sequence.  A packet the same (time, size and CRC) as one of the
+   last MGDUP taken in its band is a copy held in two stores, and dropped. */
+#define MGSTORE 64                 /* Most stores merged */
+#define MGDUP 64                   /* Recent packets remembered per band */
+
+char *stores[MGSTORE];
+int nstore = 0;
+
+struct mcur {
+   char *store;
+   struct aloc_t *aloc;
+   int naloc, *ord, nord, k, fno;
+   FILE *fd;
+   off_t off, next;                /* Next packet in cluster (0 if none) */
+   size_t siz;
+   char *buf;                      /* Head packet */
+   uint64_t t;
+};
+
+struct mdup {
+   uint64_t t;
+   uint32_t siz, crc;
+};
+
+/* Position cursor at offset off in the store file holding table entry i */
+
+void mgseek(struct mcur *c, int i, off_t off){
+   if (c->fd == NULL || c->fno != c->aloc[i].fnum) {
+      char *tmp = strdup(c->store);
+      c->fno = c->aloc[i].fnum;
+      sprintf(tmp+(strstr(c->store, "001.store")-c->store), "%03d.store", c->fno);
+      if (c->fd) fclose(c->fd);
+      c->fd = stopen(tmp);
+      if (c->fd == NULL) err("bad store file name");
+      free(tmp);
+   }
+   if (fseeko(c->fd, off, SEEK_SET)) erroff(off, "bad seek in store");
+}
+
+/* Read the cursor's next packet; returns 0 at the end of the store */
+
+int mgnext(struct mcur *c){
+   char *buf = c->buf, *bad;
+   int i, writ;
+
+   for(;;) {
+      if (c->off == 0) {            /* Start next cluster */
+	 if (c->k >= c->nord) return 0;
+	 i = c->ord[c->k++];
+	 c->off = c->aloc[i].off + 68;
+      }
+      i = c->ord[c->k-1];
+      mgseek(c, i, c->off);
+      bad = NULL;
+      writ = fread(buf, 40, 1, c->fd);
+      if (writ <= 0)
+	 bad = "Zero read from store file";
+      else if (ckend(buf)) {
+	 c->off = 0;
+	 continue;
+      } else if (!cktype(buf) || (rsyn && !ckpkt(buf)))
+	 bad = "packets not from V3 store";
+      if (bad == NULL) {
+	 c->siz = pktsiz(buf);
+	 if (c->siz > 40 && 1 != fread(buf+40, c->siz-40, 1, c->fd))
+	    bad = "Incomplete data read from store file";
+      }
+      if (bad) {
+	 if (!rsyn) erroff(c->off, bad);
+	 c->off = resync(c->fd, c->off, c->aloc[i].off+68, c->aloc[i].siz > 68 ?
+	    c->aloc[i].off+(off_t)c->aloc[i].siz : (off_t)INT64_MAX, bad);
+	 if (c->off < 0) c->off = 0;
+	 continue;
+      }
+      lsttim = c->t = dw((unsigned char*)buf+8);
+      c->next = c->off + c->siz + ((0x03 & c->siz)?4-(0x03&c->siz):0);
+      return 1;
+   }
+}
+
+/* Open a cursor on a store, ordering its clusters by first packet time */
+
+uint64_t *mgt;
+
+int mgcmp(const void *a, const void *b){
+   int i = *(int *)a, j = *(int *)b;
+   if (mgt[i] != mgt[j]) return mgt[i] < mgt[j] ? -1 : 1;
+   return i - j;
+}
+
+void mgopen(struct mcur *c, char *store){
+   char buf[108];
+   int i;
+
+   rdtable(store);
+   c->store = store;
+   c->aloc = aloc; c->naloc = naloc;
+   aloc = NULL; naloc = 0;
+   c->ord = malloc(c->naloc * sizeof(int));
+   mgt = calloc(c->naloc, sizeof(uint64_t));
+   c->buf = malloc(PKTBUF);
+   if (c->ord == NULL || mgt == NULL || c->buf == NULL) err("out of memory");
+   for(i=0; i<c->naloc; i++) {
+      mgseek(c, i, c->aloc[i].off);
+      if (1 != fread(buf, 68, 1, c->fd)) {
+	 if (!rsyn) erroff(c->aloc[i].off, "bad store section header");
+	 continue;
+      }
+      if (strncmp(buf+36, "CHTB", 4) == 0 || strncmp(buf+36, "CSTB", 4) == 0)
+	 continue;
+      if (strncmp(buf+36, "CLUS", 4)) {
+	 fprintf(stderr,"%-4.4s -- unrecognized\n", buf+36);
+	 if (!rsyn) erroff(c->aloc[i].off,"unrecognized table section");
+	 st.nrsyn += 1;
+	 continue;
+      }
+      if (1 == fread(buf+68, 40, 1, c->fd) && cktype(buf+68) && !ckend(buf+68))
+	 mgt[i] = dw((unsigned char*)buf+68+8);
+      c->ord[c->nord++] = i;
+   }
+   qsort(c->ord, c->nord, sizeof(int), mgcmp);
+   free(mgt);
+   if (verb) fprintf(msgs, "merging %s: %d clusters\n", store, c->nord);
+   if (!mgnext(c)) c->t = UINT64_MAX;
+}
+
+/* Whether packet is a copy of one recently taken in its band */
+
+int mgdup(unsigned char *buf, size_t siz){
+   static struct mdup dup[256][MGDUP];
+   static int ndup[256];
+   struct mdup d;
+   int i, b = buf[27];
+
+   d.t = dw(buf+8); d.siz = siz; d.crc = crc32(0L, buf, siz);
+   for(i=0; i<MGDUP && i<ndup[b]; i++)
+      if (dup[b][i].t == d.t && dup[b][i].siz == d.siz && dup[b][i].crc == d.crc)
+	 return 1;
+   dup[b][ndup[b]++ % MGDUP] = d;
+   if (ndup[b] >= 2*MGDUP) ndup[b] -= MGDUP;
+   return 0;
+}
+
+/* Merge the stores' packets, passing them on like rdstore */
+
+void *mgstore(void *arg){
+   struct mcur *c = calloc(nstore, sizeof(struct mcur));
+   int i, m;
+
+   if (c == NULL) err("out of memory");
+   for(i=0; i<nstore; i++) mgopen(c+i, stores[i]);
+   for(;;) {
+      double t;
+      for(m=0, i=1; i<nstore; i++)
+	 if (c[i].t < c[m].t) m = i;
+      if (c[m].t == UINT64_MAX) break;
+      if (mgdup((unsigned char*)c[m].buf, c[m].siz)) {
+	 st.ndup += 1; st.bytes += c[m].siz;
+	 if (verb>1) fprintf(msgs, "%s: duplicate packet at offset %llx\n",
+	    c[m].store, (long long)c[m].off);
+      } else if (pipl) {
+	 struct pent e;
+	 unsigned char *p;
+	 e.len = (sizeof(e) + c[m].siz + 7) & ~(size_t)7;
+	 e.ix = 0; e.off = c[m].off; e.next = c[m].next; e.siz = c[m].siz;
+	 p = rngput(&pkts, e.len);
+	 memcpy(p, &e, sizeof(e)); memcpy(p+sizeof(e), c[m].buf, c[m].siz);
+	 rngpost(&pkts, e.len);
+      } else
+	 dopkt(c[m].store, 0, c[m].off, c[m].siz, (unsigned char*)c[m].buf,
+	    c[m].next);
+      c[m].off = c[m].next;
+      t = stats ? now() : 0;
+      if (!mgnext(c+m)) c[m].t = UINT64_MAX;
+      if (stats) st.tio += now() - t;
+   }
+   for(i=0; i<nstore; i++) {
+      if (c[i].fd) fclose(c[i].fd);
+      free(c[i].aloc); free(c[i].ord); free(c[i].buf);
+   }
+   free(c);
+   atomic_store_explicit(&pkts.eof, 1, memory_order_release);
+   return NULL;
+}
+
+int main(int argc, char *argv[]){
+   char *store = NULL, *wfile = NULL, *tmpfn = NULL, *sdsroot = NULL;
+   int i, six;
+   uint64_t sig;
 
    prog = argv[0];
+   msgs = stdout;
 
    for(i=0;i<sizeof(snam);i++) snam[i] = ' ';
    for(i=0;i<sizeof(snet);i++) snet[i] = 'Y';
@@ -575,20 +2155,38 @@ int main(int argc, char *argv[]){
       if (argv[i][0] == '-') { /* Check for option */
          if (0 == strcmp(argv[i], "-z")) {
 	    i += 1;
-	    strm[0].fd = fopen(argv[i], "w");
-	    if (strm[0].fd == NULL) err("bad -z file name");
+	    six = getstrm(65);
+	    strm[six].fn = argv[i];
          } else if (0 == strcmp(argv[i], "-e")) {
 	    i += 1;
-	    strm[2].fd = fopen(argv[i], "w");
-	    if (strm[2].fd == NULL) err("bad -e file name");
+	    six = getstrm(69);
+	    strm[six].fn = argv[i];
          } else if (0 == strcmp(argv[i], "-n")) {
 	    i += 1;
-	    strm[1].fd = fopen(argv[i], "w");
-	    if (strm[1].fd == NULL) err("bad -n file name");
+	    six = getstrm(67);
+	    strm[six].fn = argv[i];
+         } else if (0 == strcmp(argv[i], "-all")) {
+	    i += 1;
+	    allpfx = argv[i];
+         } else if (0 == strcmp(argv[i], "-sds")) {
+	    i += 1;
+	    sdsroot = argv[i];
+         } else if (0 == strcmp(argv[i], "-map")) {
+	    /* Parse band to channel code mapping: <band>:<chan>[:<loc>] */
+	    char chn[4];
+	    int band, n = 0;
+	    i += 1;
+	    if (2 != sscanf(argv[i], "%d:%3[^:]%n", &band, chn, &n)
+	     || band < 0 || band > 255 || band == 71 || strlen(chn) != 3
+	     || (argv[i][n] && (argv[i][n] != ':' || strlen(argv[i]+n+1) != 2)))
+	       err("bad -map value");
+	    six = getstrm(band);
+	    strcpy(strm[six].chid, chn);
+	    if (argv[i][n]) strcpy(strm[six].loc, argv[i]+n+1);
+	    strm[six].named = 1;
          } else if (0 == strcmp(argv[i], "-soh")) {
 	    i += 1;
-	    sohd.fd = fopen(argv[i], "w");
-	    if (sohd.fd == NULL) err("bad -soh file name");
+	    sohd.fn = argv[i];
          } else if (0 == strcmp(argv[i], "-item")) {
 	    int j;
 	    for (j=0;j<N_SOHI;j++){
@@ -609,11 +2207,17 @@ int main(int argc, char *argv[]){
 	    }
 	    if (j>=N_SOHF) err("bad SOH -fmt name");
 	    i += 1;
+         } else if (0 == strcmp(argv[i], "-S")) {
+	    i += 1; six = strlen(argv[i]);
+	    memcpy(snam,argv[i],six>sizeof(snam)?sizeof(snam):six);
+         } else if (0 == strcmp(argv[i], "-N")) {
+	    i += 1; six = strlen(argv[i]);
+	    memcpy(snet,argv[i],six>sizeof(snet)?sizeof(snet):six);
          } else if (0 == strcmp(argv[i], "-sohdt")) {
             char *p;
 	    i += 1; six = strlen(argv[i]);
             sohdt = strtol(argv[i],&p,10);
-            if (p-argv[i] != six) err("bad -sohdt value");
+            if (p-argv[i] != six || sohdt <= 0) err("bad -sohdt value");
 	 } else if (0 == strcmp(argv[i], "-l")) {
 	    /* Parse leap second syntax: -l {+/-} {jun|dec} <year> */
 	    int dir;
@@ -622,19 +2226,19 @@ int main(int argc, char *argv[]){
 	       fprintf(stderr, "missing -l args\n"); continue;
 	    }
 	    if (0 == strcmp(argv[i+1], "-")) 
-	       tm.tm_sec = 59, dir = 0x10;
+	       tm.tm_sec = 59, dir = 0x20;
 	    else if (0 == strcmp(argv[i+1], "+")) 
-	       tm.tm_sec = 60, dir = 0x20;
+	       tm.tm_sec = 60, dir = 0x10;
 	    else {
 	       i += 1;
 	       fprintf(stderr, "bad -l arg: + or -\n"); continue;
 	    }
 	    if (0 == strcmp(argv[i+2], "jun")) {
 	       tm.tm_mon = 6-1;
-	       tm.tm_mday = 30-1;
+	       tm.tm_mday = 30;
 	    } else if (0 == strcmp(argv[i+2], "dec")) {
 	       tm.tm_mon = 12-1;
-	       tm.tm_mday = 31-1;
+	       tm.tm_mday = 31;
 	    } else {
 	       i += 2;
 	       fprintf(stderr, "bad -l arg: jun or dec\n"); continue;
@@ -646,139 +2250,164 @@ int main(int argc, char *argv[]){
 	    }
 	    tm.tm_hour = 23;
 	    tm.tm_min = 59;
-	    lptm = mktime(&tm);
+	    lptm = timegm(&tm);
 	    lpsc = dir;
 	    i += 3;
+         } else if (0 == strcmp(argv[i], "-w")) {
+	    i += 1;
+	    wfile = argv[i];
+         } else if (0 == strcmp(argv[i], "-tears")) {
+	    i += 1;
+	    tearfn = argv[i];
+         } else if (0 == strcmp(argv[i], "-tearfix")) {
+	    tfix = 1;
+         } else if (0 == strcmp(argv[i], "-c")) {
+	    zout = 1;
+         } else if (0 == strcmp(argv[i], "-ckpt")) {
+	    i += 1;
+	    ckfile = argv[i];
+         } else if (0 == strcmp(argv[i], "-resume")) {
+	    resume = 1;
+         } else if (0 == strcmp(argv[i], "-follow")) {
+	    i += 1;
+	    follow = 1; tmpfn = argv[i];
+         } else if (0 == strcmp(argv[i], "-poll")) {
+	    i += 1;
+	    if (1 != sscanf(argv[i], "%d", &pollsec) || pollsec <= 0)
+	       err("bad -poll value");
+         } else if (0 == strcmp(argv[i], "-img")) {
+	    i += 1;
+	    img = e2mount(argv[i]);
+	    if (img == NULL) err("-img not an ext2 file system");
+         } else if (0 == strcmp(argv[i], "-pipe")) {
+	    pipl = 1;
+         } else if (0 == strcmp(argv[i], "-resync")) {
+	    rsyn = 1;
+         } else if (0 == strcmp(argv[i], "-stats")) {
+	    stats = 1;
          } else if (0 == strcmp(argv[i], "-v")) {
-	    verb = 1;
+	    verb += 1;
          } else if (0 == strcmp(argv[i], "-h")) {
 	    usage();
 	 } else {
 	    fprintf(stderr, "bad arg (ignored): %s\n", argv[i]);
 	 }
       } else {
-         store = argv[i];
+	 if (nstore >= MGSTORE) err("too many stores");
+         store = stores[nstore++] = argv[i];
       }
    }
 
+   /* Keep messages out of any output to the standard output, from the
+      start (streams under -all are only opened once the store is read) */
+   for(i=0; i<=nstrm; i++)
+      if (sst(i)->fn && 0 == strcmp(sst(i)->fn, "-")) msgs = stderr;
+   if ((allpfx && 0 == strcmp(allpfx, "-"))
+    || (tearfn && 0 == strcmp(tearfn, "-"))) msgs = stderr;
+
    if (soh_itm == SOH_POS
     && soh_fmt != SOH_FMT_TEXT) err("SOH P item only -fmt text, sorry");
 
-   /* Open store file */
-
    if (store == NULL) err("no store file given");
-   fd = fopen(store, "r");
-   if (fd == NULL) err("bad store file name");
-
-   /* Verify NMX volume, read allocation table */
-
-   siz = fread(buf, 48, 1, fd);
-
-   if(strncmp(buf, "NMXV", 4) != 0) err("not a NMX store");
-
-   if(strncmp(buf+32, "VOLFALOC", 8) != 0) err("missing allocation table");
-
-   /* Find store file number position */
-   cbuf = strstr(store, "001.store");
-   if(cbuf == NULL)
-      err("unusual store name (looking for 001.store suffix) -- correct?");
-   six = cbuf-store;
-
-   fsiz = fsize(fd);
-   scum = 0, fno = 1;
-   if (verb) printf("store file %s size %zx\n", store, fsiz);
-
-   /* Decode table */
-   siz = fw((unsigned char*)buf+32+8); tmp = fw((unsigned char*)buf+32+12);
-   store_size = (int)siz;
-   aloc = calloc(siz, sizeof(struct aloc_t));
-   if (aloc == NULL) err("allocation table error");
-   cbuf = malloc(tmp);
-   if (cbuf == NULL) err("table buffer error");
-   tmp = fread(cbuf, tmp-48, 1, fd);
-   for(i=0;i<siz;i++){
-      int j = i*16;
-      aloc[i].off = (off_t)dw((unsigned char*)cbuf+j+ 4) - scum;
-      aloc[i].siz = fw((unsigned char*)cbuf+j+12);
-//    printf("%d off %zx\n",i, (size_t)aloc[i].off);
-      if (aloc[i].off >= fsiz) {
-         char *tmp = strdup(store);
-         fno += 1; scum += fsiz;
-         aloc[i].off = (off_t)dw((unsigned char*)cbuf+j+ 4) - scum;
-	 sprintf(tmp+six, "%03d.store", fno);
-	 fclose(fd);
-	 fd = fopen(tmp, "r");
-         if (fd == NULL) err("bad store file name");
-         fsiz = fsize(fd);
-	 if (verb) printf("store file %s size %zx\n", tmp, fsiz);
-	 free(tmp);
-	 if (fsiz<=0) break;
-      }
-      aloc[i].fnum = fno;
+   store = stores[0];
+   if (nstore > 1 && (ckfile || follow))
+      err("several stores not possible with -ckpt or -follow");
+   if (resume && ckfile == NULL) err("-resume needs a -ckpt file");
+   if (pollsec && !follow) err("-poll needs -follow");
+   if (follow) {
+      struct stat sb;
+      if (ckfile || resume) err("-follow not possible with -ckpt or -resume");
+      ckfile = tmpfn;
+      resume = 0 == stat(ckfile, &sb);
+   }
+   if (ckfile) {
+      if (zout) err("-ckpt not possible with compressed output, sorry");
+      for(i=0; i<=nstrm; i++)
+         if (sst(i)->fn && 0 == strcmp(sst(i)->fn, "-"))
+	    err("-ckpt not possible with output to standard output");
+      if (allpfx && 0 == strcmp(allpfx, "-"))
+	 err("-ckpt not possible with output to standard output");
    }
-   free(cbuf);
-   if (verb) printf("store size %d (%x)\n", store_size, store_size);
-
-   /* Process each part of allocation table */
 
-   atsiz = siz; fno = 1; fclose(fd); fd = fopen(store, "r");
-   for(i=0; i<atsiz; i++){
-      if (verb) printf("alloc tbl walk: %d fno %d off %zx: ",
-         i, aloc[i].fnum, (size_t)aloc[i].off);
-      if (fno != aloc[i].fnum) {
-         char *tmp = strdup(store);
-         fno = aloc[i].fnum;
-	 sprintf(tmp+six, "%03d.store", fno);
-	 fclose(fd);
-	 fd = fopen(tmp, "r");
-         if (fd == NULL) err("bad store file name");
-	 free(tmp);
-      }
-      off = fseeko(fd, aloc[i].off, SEEK_SET);
+   if (tfix) {
+      if (!lpsc) err("-tearfix needs -l");
+      if (zout || ckfile)
+         err("-tearfix not possible with -c or -ckpt, sorry");
+      for(i=0; i<nstrm; i++)
+         if (strm[i].fn && 0 == strcmp(strm[i].fn, "-"))
+	    err("-tearfix not possible with output to standard output");
+      if (allpfx && 0 == strcmp(allpfx, "-"))
+	 err("-tearfix not possible with output to standard output");
+   }
+   if (sdsroot) {
+      if (tfix) err("-tearfix not possible with -sds, sorry");
+      sds = sdsopen(sdsroot, SDSFD);
+      if (sds == NULL) err("can't set up -sds archive");
+   }
+   if (tearfn) {
+      if (ckfile) err("-tears not possible with -ckpt, sorry");
+      tearfd = opnout(tearfn, "w");
+      if (tearfd == NULL) err("can't open -tears file");
+   }
 
-      siz = fread(buf, 68, 1, fd);
+   if (resume) rdckpt(store);
+   opnall();
+   if (wfile) readwin(wfile);
+   if (stats) {
+      st.t0 = now();
+      signal(SIGUSR1, onusr1);
+   }
 
-      if (strncmp(buf+36, "CHTB", 4) == 0) {
-	 if (verb) printf("CHTB: %zx, %zx\n", (size_t)off, aloc[i].siz);
-      } else if (strncmp(buf+36, "CSTB", 4) == 0) {
-	 if (verb) printf("CSTB: %zx, %zx\n", (size_t)off, aloc[i].siz);
-      } else if (strncmp(buf+36, "CLUS", 4) == 0) {
-	 if (verb) printf("CLUS: %zx, %zx (start %zx)\n",
-	    (size_t)off, aloc[i].siz, (size_t)aloc[i].off+68);
-         off = aloc[i].off+68;
-	 do {
-	    int writ = fread(buf, 40, 1, fd);
-	    if (writ <= 0)
-	       erroff(off, "Zero read from store file");
-	    if (ckend(buf)) break;
-	    if (!cktype(buf)) erroff(off,"packets not from V3 store");
-	    siz = hw((unsigned char*)buf+2) & 0x1fff; /* Mask high bit flags */
-	    if ((buf[2]>>5 & 0x03) == 3) siz |=
-               hw((unsigned char*)buf+29+8) << 13;
-	    if ((buf[2]>>5 & 0x03) == 2) siz |=
-               hw((unsigned char*)buf+29+1) << 13;
-	    if (siz > 40)
-	       writ = fread(buf+40, siz-40, 1, fd);
-	    if (writ <= 0)
-	       erroff(off, "Incomplete data read from store file");
-	    dhdr(off, siz, (unsigned char*)buf);
-	    off += siz + /* Seems to be necessary to round to word boundary */
-	           ((0x03 & siz)?4-(0x03&siz):0);
-	    writ = fseeko(fd, off, SEEK_SET);
-	    if (writ) erroff(off,"bad seek in cluster");
-	 } while(ok);
-      } else {
-        fprintf(stderr,"%-4.4s -- unrecognized\n", buf+36);
-	erroff(aloc[i].off,"unrecognized table section");
-      }
+   /* Read the allocation table and process each part of it, with -pipe
+      reading in one thread and decoding in this one.  With -poll, do it
+      again each time the store changes. */
+
+   for(;;) {
+      sig = stsig(store);
+      if (nstore == 1) rdtable(store);
+      if (pipl) {
+	 pthread_t tid;
+	 struct pent e;
+	 unsigned char *p;
+	 if (pkts.buf == NULL) mkring(&pkts, PRNGSIZ, sizeof(e)+PKTBUF+8);
+	 atomic_store_explicit(&pkts.eof, 0, memory_order_release);
+	 if (pthread_create(&tid, NULL, nstore > 1 ? mgstore : rdstore, store))
+	    err("can't start store reader thread");
+	 while ((p = rngget(&pkts))) {
+	    memcpy(&e, p, sizeof(e));
+	    dopkt(store, e.ix, e.off, e.siz, p+sizeof(e), e.next);
+	    rngdone(&pkts, e.len);
+	 }
+	 if (pthread_join(tid, NULL))
+	    err("can't finish store reader thread");
+      } else if (nstore > 1)
+	 (void)mgstore(store);
+      else
+	 (void)rdstore(store);
+      if (!follow) break;
+
+      /* Save where this pass got to, then wait for the store to grow */
+      wrckpt(store, ck.ix, ck.off);
+      ckbytes = st.bytes + CKPTSIZ;
+      if (stats) stprt();
+      if (pollsec == 0) break;
+      while (sig == stsig(store)) sleep(pollsec);
    }
 
-   if (sohd.fd && soh_fmt == SOH_FMT_MSEED && sohcnt) {
-      phw(sohmsd+30, sohcnt); phw(sohmsd+32, -sohdt); /* count, SRF */
-      i = fwrite(sohmsd, sizeof(sohmsd), 1, sohd.fd);
-      if (i<=0)
-         errcnt(sohblk, "error flushing SOH MSEED data");
+   if (!follow) {
+      if (sohd.fd && soh_fmt == SOH_FMT_MSEED && sohcnt) sohput();
+      if (sohd.fd && soh_fmt == SOH_FMT_COL) sohcput();
    }
+   wrstop();
+   if (tfix) tearfix();
+   clsout();
+   if (sds && sdsdup(sds))
+      fprintf(stderr, "%s: %ld records already in SDS archive, left out\n",
+         prog, sdsdup(sds));
+   if (sds && sdsclose(sds)) err("error closing SDS archive files");
+   if (tearfd && fclose(tearfd)) err("error writing -tears file");
+   if (ckfile && !follow) (void)remove(ckfile);
+   if (stats && !follow) stprt();
 
    return 0;
 }